@@ -198,8 +198,9 @@ uint64_t AVLTree_PAMTree_Wrapper::degree(uint64_t vertex) const {
     return degree;
 }
 
+// the PAM blocks keep no weights, every edge weighs 0
 double AVLTree_PAMTree_Wrapper::get_weight(uint64_t source, uint64_t destination) const {
-    throw driver::error::FunctionNotImplementedError("get_weight");
+    return has_edge(source, destination) ? 0.0 : std::numeric_limits<double>::quiet_NaN();
 }
 
 uint64_t AVLTree_PAMTree_Wrapper::logical2physical(uint64_t vertex) const {
@@ -388,7 +389,7 @@ uint64_t AVLTree_PAMTree_Wrapper::Snapshot::intersect(uint64_t vtx_a, uint64_t v
 }
 
 double AVLTree_PAMTree_Wrapper::Snapshot::get_weight(uint64_t source, uint64_t destination) const {
-    throw driver::error::FunctionNotImplementedError("snapshot::get_weight");
+    return has_edge(source, destination) ? 0.0 : std::numeric_limits<double>::quiet_NaN();
 }
 
 uint64_t AVLTree_PAMTree_Wrapper::Snapshot::vertex_count() const {
@@ -13,6 +13,17 @@
 
 using namespace container;
 
+// overrides the container tuning knobs given in the config file
+inline void apply_container_config(const DriverConfig & config) {
+    if (config.vector_size) container::config::DEFAULT_VECTOR_SIZE = *config.vector_size;
+    if (config.hash_neighbor_size) container::config::HASH_NEIGHBOR_SIZE = *config.hash_neighbor_size;
+    if (config.hash_read_ratio) container::config::HASH_READ_RATIO = *config.hash_read_ratio;
+    if (config.gc_interval) container::config::GC_INTERVAL_MS = *config.gc_interval;
+    if (config.gc_workers) container::config::GC_WORKERS = *config.gc_workers;
+    if (config.gc_slice) container::config::GC_SLICE = *config.gc_slice;
+    if (config.snapshot_refresh_us) container::config::SNAPSHOT_REFRESH_US = *config.snapshot_refresh_us;
+}
+
 template <typename ContainerType>
 class WrapperBase {
 protected:
@@ -27,7 +38,12 @@ public:
     virtual ~WrapperBase() = default;
 
     bool is_directed() const { return m_is_directed; }
+#ifdef ENABLE_WEIGHT
     bool is_weighted() const { return m_is_weighted; }
+#else
+    // the indexes keep no weight column, every edge reports 0
+    bool is_weighted() const { return false; }
+#endif
     bool is_empty() const { return vertex_count() == 0; }
 
     void set_max_threads(int max_threads) {};
@@ -90,9 +106,9 @@ public:
         auto tx = tm.get_write_transaction();
         bool inserted = true;
         try {
-            tx.insert_edge(source, destination);
+            tx.insert_edge(source, destination, weight);
             if (!m_is_directed) {
-                tx.insert_edge(destination, source);
+                tx.insert_edge(destination, source, weight);
             }
             inserted = tx.commit();
         } catch (const std::exception& e) {
@@ -112,7 +128,20 @@ public:
     }
 
     virtual bool remove_edge(uint64_t source, uint64_t destination) {
-        throw driver::error::FunctionNotImplementedError("remove_edge");
+        auto tx = tm.get_write_transaction();
+        bool removed = true;
+        try {
+            tx.remove_edge(source, destination);
+            if (!m_is_directed) {
+                tx.remove_edge(destination, source);
+            }
+            removed = tx.commit();
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            tx.abort();
+            removed = false;
+        }
+        return removed;
     }
 
 
@@ -139,9 +168,27 @@ public:
                 try {
                     for (uint64_t i = start; i < end; i++) {
                         auto edge = edges[i].e;
-                        tx.insert_edge(edge.source, edge.destination);
+                        tx.insert_edge(edge.source, edge.destination, edge.weight);
+                        if (!m_is_directed) {
+                            tx.insert_edge(edge.destination, edge.source, edge.weight);
+                        }
+                    }
+                    tx.commit();
+                } catch (std::exception &e) {
+                    std::cerr << e.what() << std::endl;
+                    tx.abort();
+                    return false;
+                }
+                break;
+            }
+            case operationType::DELETE: {
+                auto tx = tm.get_write_transaction();
+                try {
+                    for (uint64_t i = start; i < end; i++) {
+                        auto edge = edges[i].e;
+                        tx.remove_edge(edge.source, edge.destination);
                         if (!m_is_directed) {
-                            tx.insert_edge(edge.destination, edge.source);
+                            tx.remove_edge(edge.destination, edge.source);
                         }
                     }
                     tx.commit();
@@ -153,7 +200,7 @@ public:
                 break;
             }
             default:
-                throw driver::error::FunctionNotImplementedError("run_batch_edge_update:: except INSERT");
+                throw driver::error::FunctionNotImplementedError("run_batch_edge_update:: except INSERT and DELETE");
                 break;
         }
         return true;
@@ -238,8 +285,9 @@ public:
             m_transaction.edges(index, std::forward<F>(callback));
         }
 
+        // without ENABLE_WEIGHT every edge weighs 0, NaN if the edge does not exist
         double get_weight(uint64_t source, uint64_t destination) const {
-            throw driver::error::FunctionNotImplementedError("get_weight");
+            return m_transaction.get_weight(source, destination);
         }
 
         void get_neighbor_addr(uint64_t index) const {
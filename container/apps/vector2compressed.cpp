@@ -0,0 +1,43 @@
+#include "edge_index/compressed.hpp"
+#include "vertex_index/vector.hpp"
+
+#include "apps/base_2pl.h"
+
+using EdgeEntry = container::VersionedEdgeEntry;
+
+template<typename T>
+using EdgeIndexTemplate = container::CompressedEdgeIndex<T>;
+
+template<template<typename> class EdgeIndexTemplate, typename EdgeEntry>
+using VertexEntryTemplate = container::VertexEntry<EdgeIndexTemplate, EdgeEntry>;
+
+template<typename VertexEntry, template<typename> class EdgeIndexTemplate, typename EdgeEntry>
+using VertexIndexTemplate = container::VectorVertexIndex<VertexEntryTemplate, EdgeIndexTemplate, EdgeEntry>;
+
+using vector2compressed = container::Container<
+    VertexIndexTemplate,
+    VertexEntryTemplate,
+    EdgeIndexTemplate,
+    EdgeEntry
+>;
+
+class Vector2Compressed : public WrapperBase<vector2compressed> {
+public:
+    explicit Vector2Compressed(bool is_directed = false, bool is_weighted = true)
+        : WrapperBase<vector2compressed>(is_directed, is_weighted) {}
+
+    static std::string repl() {
+        return std::string{"Vector_Compressed_Wrapper"};
+    }
+};
+
+namespace wrapper {
+    void execute(const DriverConfig & config) {
+       apply_container_config(config);
+       auto wrapper = Vector2Compressed(false, true);
+       Driver<Vector2Compressed, std::shared_ptr<Vector2Compressed::Snapshot>> d(wrapper, config);
+       d.execute(config.workload_type, config.target_stream_type);
+   }
+}
+
+#include "driver_main.h"
\ No newline at end of file
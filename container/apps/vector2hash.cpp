@@ -0,0 +1,43 @@
+#include "edge_index/hashmap.hpp"
+#include "vertex_index/vector.hpp"
+
+#include "apps/base_2pl.h"
+
+using EdgeEntry = container::VersionedEdgeEntry;
+
+template<typename T>
+using EdgeIndexTemplate = container::HashmapEdgeIndex<T>;
+
+template<template<typename> class EdgeIndexTemplate, typename EdgeEntry>
+using VertexEntryTemplate = container::VertexEntry<EdgeIndexTemplate, EdgeEntry>;
+
+template<typename VertexEntry, template<typename> class EdgeIndexTemplate, typename EdgeEntry>
+using VertexIndexTemplate = container::VectorVertexIndex<VertexEntryTemplate, EdgeIndexTemplate, EdgeEntry>;
+
+using vector2hash = container::Container<
+    VertexIndexTemplate,
+    VertexEntryTemplate,
+    EdgeIndexTemplate,
+    EdgeEntry
+>;
+
+class Vector2Hash : public WrapperBase<vector2hash> {
+public:
+    explicit Vector2Hash(bool is_directed = false, bool is_weighted = true)
+        : WrapperBase<vector2hash>(is_directed, is_weighted) {}
+
+    static std::string repl() {
+        return std::string{"Vector_Hash_Wrapper"};
+    }
+};
+
+namespace wrapper {
+    void execute(const DriverConfig & config) {
+       apply_container_config(config);
+       auto wrapper = Vector2Hash(false, true);
+       Driver<Vector2Hash, std::shared_ptr<Vector2Hash::Snapshot>> d(wrapper, config);
+       d.execute(config.workload_type, config.target_stream_type);
+   }
+}
+
+#include "driver_main.h"
\ No newline at end of file
@@ -33,6 +33,7 @@ public:
 
 namespace wrapper {
     void execute(const DriverConfig & config) {
+       apply_container_config(config);
        auto wrapper = Vector2Logblock(false, true);
        Driver<Vector2Logblock, std::shared_ptr<Vector2Logblock::Snapshot>> d(wrapper, config);
        d.execute(config.workload_type, config.target_stream_type);
@@ -32,6 +32,7 @@ public:
 
 namespace wrapper {
     void execute(const DriverConfig & config) {
+       apply_container_config(config);
        auto wrapper = Vector2PMA(false, true);
        Driver<Vector2PMA, std::shared_ptr<Vector2PMA::Snapshot>> d(wrapper, config);
        d.execute(config.workload_type, config.target_stream_type);
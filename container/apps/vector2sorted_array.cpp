@@ -32,6 +32,7 @@ public:
 
 namespace wrapper {
     void execute(const DriverConfig & config) {
+       apply_container_config(config);
        auto wrapper = Vector2Sorted_array(false, true);
        Driver<Vector2Sorted_array, std::shared_ptr<Vector2Sorted_array::Snapshot>> d(wrapper, config);
        d.execute(config.workload_type, config.target_stream_type);
@@ -5,7 +5,13 @@
 #include <iostream>
 #include <vector>
 #include <functional>
+#include <limits>
+#include <atomic>
+#include <algorithm>
 #include "utils/types.hpp"
+#include "utils/config.hpp"
+#include "utils/dirty_set.hpp"
+#include "utils/worker_pool.hpp"
 #include "types/types.hpp"
 
 namespace container {
@@ -43,8 +49,13 @@ namespace container {
         using EdgeIndex = EdgeIndexTemplate<EdgeEntry>;
     
     public:
+        // maps a timestamp to one no open snapshot is older than, exact at least up to the timestamp
+        using SnapshotBound = std::function<uint64_t(uint64_t)>;
+
         // Ctor & Dtor
-        Container(bool is_directed, bool is_weighted): m_is_directed(is_directed), m_is_weighted(is_weighted), m_vertex_count(0) {
+        // without snapshot_bound every degree version stays until gc drops it
+        Container(bool is_directed, bool is_weighted, SnapshotBound snapshot_bound = {})
+            : m_is_directed(is_directed), m_is_weighted(is_weighted), m_vertex_count(0), m_snapshot_bound(std::move(snapshot_bound)) {
             this->vertex_index = new VertexIndex();
         }
 
@@ -72,6 +83,16 @@ namespace container {
             vertex_index->unlock(lock);
         }
 
+#ifdef ENABLE_OPTIMISTIC_READ
+        std::atomic<uint64_t>& get_version(uint64_t vertex) const {
+            auto ptr = vertex_index->get_entry(vertex);
+            if (ptr == nullptr) {
+                throw std::runtime_error("Vertex does not exist");
+            }
+            return ptr->get_version();
+        }
+#endif
+
         // Graph Operations, locks has been acquired
         bool is_directed() const {
             return m_is_directed;
@@ -105,23 +126,40 @@ namespace container {
         }
 
         bool has_edge(uint64_t src, uint64_t dest, uint64_t timestamp) const {
-            auto ptr = vertex_index->get_neighbor_ptr(src);
+            auto ptr = vertex_index->get_entry(src);
             if (!has_vertex(dest) || ptr == nullptr) {
                 return false;
             }
             return ptr->has_edge(src, dest, timestamp);
         }
 
+        // NaN if the edge is not visible at timestamp
+        double get_weight(uint64_t src, uint64_t dest, uint64_t timestamp) const {
+            auto ptr = vertex_index->get_entry(src);
+            if (ptr == nullptr) return std::numeric_limits<double>::quiet_NaN();
+            return ptr->get_weight(dest, timestamp);
+        }
+
         uint64_t intersect(uint64_t vtx_a, uint64_t vtx_b, uint64_t timestamp) const {
-            auto ptr_a = vertex_index->get_neighbor_ptr(vtx_a);
-            auto ptr_b = vertex_index->get_neighbor_ptr(vtx_b);
+            auto ptr_a = vertex_index->get_entry(vtx_a);
+            auto ptr_b = vertex_index->get_entry(vtx_b);
+            if constexpr (intersect::has_fast_probe<EdgeIndexTemplate<EdgeEntry>>::value) {
+                // a hub against a small neighborhood: look the small side up in the hub instead of collecting it
+                uint64_t degree_a = ptr_a->find_degree(timestamp).value_or(0), degree_b = ptr_b->find_degree(timestamp).value_or(0);
+                if (degree_a > degree_b) {
+                    std::swap(ptr_a, ptr_b);
+                    std::swap(vtx_a, vtx_b);
+                    std::swap(degree_a, degree_b);
+                }
+                if (degree_b / std::max<uint64_t>(degree_a, 1) >= intersect::GALLOP_RATIO) return intersect::probe(*ptr_a, *ptr_b, vtx_b, timestamp);
+            }
             return ptr_a->intersect(*ptr_b, timestamp);
         }
 
         auto begin(uint64_t src, uint64_t timestamp) const {
-            auto ptr = vertex_index->get_neighbor_ptr(src);
+            auto ptr = vertex_index->get_entry(src);
 #ifdef ENABLE_LOCK
-            return ptr->get_begin(timestamp, vertex_index->get_entry(src)->get_lock());
+            return ptr->get_begin(timestamp, ptr->get_lock());
 #else
             return ptr->get_begin(timestamp);
 #endif
@@ -143,48 +181,66 @@ namespace container {
             ptr->get_neighbor(neighbor, timestamp);
         }
 
+        // the NeighborEntry is only allocated once the vertex outgrows its inline edges
         bool insert_vertex(uint64_t vertex, uint64_t timestamp) {
-            auto ptr = new NeighborEntry<EdgeIndexTemplate, EdgeEntry>();
-            bool flag = vertex_index->insert_vertex(vertex, ptr, timestamp);
+            bool flag = vertex_index->insert_vertex(vertex, nullptr, timestamp);
             if (flag) m_vertex_count++;
             return true;
         }
 
-        bool insert_edge(uint64_t src, uint64_t dest, uint64_t timestamp) {
-            auto ptr = vertex_index->get_neighbor_ptr(src);
-            if(ptr == nullptr) {
+        bool insert_edge(uint64_t src, uint64_t dest, uint64_t timestamp, double weight = 0.0) {
+            auto vertex_ptr = vertex_index->get_entry(src);
+            if(vertex_ptr == nullptr) {
                 throw std::runtime_error("Vertex does not exist");
             }
-            bool flag = ptr->insert_edge(dest, timestamp);
+            bool flag = vertex_ptr->insert_edge(dest, timestamp, weight);
             if (flag) {
                 // m_edge_count++;
                 
                 // update degree
-                auto vertex_ptr = vertex_index->get_entry(src);
                 auto cur_degree = vertex_ptr->get_degree(timestamp);
-                vertex_ptr->update_degree(cur_degree + 1, timestamp);
+                vertex_ptr->update_degree(cur_degree + 1, timestamp, oldest_snapshot());
+                vertex_ptr->fold_delta(timestamp, oldest_snapshot());
+                mark_dirty(src, timestamp);
             }
             return flag;
         }
 
         // Batch update
-        bool insert_edge_batch(uint64_t src, const std::vector<uint64_t> &dest_list, uint64_t timestamp) {
-            auto ptr = vertex_index->get_neighbor_ptr(src);
-            if(ptr == nullptr) {
+        bool insert_edge_batch(uint64_t src, const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {}) {
+            auto vertex_ptr = vertex_index->get_entry(src);
+            if(vertex_ptr == nullptr) {
                 throw std::runtime_error("Vertex does not exist");
             }
-            uint64_t inserted_num = ptr->insert_edge_batch(dest_list, timestamp);
+            uint64_t inserted_num = vertex_ptr->insert_edge_batch(dest_list, timestamp, weight_list);
             if (inserted_num) {
                 // m_edge_count += inserted_num;
                 
                 // update degree
-                auto vertex_ptr = vertex_index->get_entry(src);
                 auto cur_degree = vertex_ptr->get_degree(timestamp);
-                vertex_ptr->update_degree(cur_degree + inserted_num, timestamp);
+                vertex_ptr->update_degree(cur_degree + inserted_num, timestamp, oldest_snapshot());
+                vertex_ptr->fold_delta(timestamp, oldest_snapshot());
+                mark_dirty(src, timestamp);
             }
             return (inserted_num != 0);
         }
 
+        bool remove_edge(uint64_t src, uint64_t dest, uint64_t timestamp) {
+            auto vertex_ptr = vertex_index->get_entry(src);
+            if(vertex_ptr == nullptr) {
+                throw std::runtime_error("Vertex does not exist");
+            }
+            bool flag = vertex_ptr->remove_edge(dest, timestamp);
+            if (flag) {
+                // update degree
+                auto cur_degree = vertex_ptr->get_degree(timestamp);
+                vertex_ptr->update_degree(cur_degree - 1, timestamp, oldest_snapshot());
+                vertex_ptr->fold_delta(timestamp, oldest_snapshot());
+                mark_dirty(src, timestamp);
+            }
+            return flag;
+        }
+
         void clear() {
             vertex_index->clear();
             m_vertex_count = 0;
@@ -201,36 +257,44 @@ namespace container {
 
         template<typename F>
         void edges(uint64_t src, F&& callback, uint64_t timestamp) const {
-            auto ptr = vertex_index->get_neighbor_ptr(src);
+            auto ptr = vertex_index->get_entry(src);
             if (ptr == nullptr) {
                 throw std::runtime_error("Vertex does not exist");
             }
             ptr->edges(callback, timestamp);
         }
 
-#ifdef ENABLE_TIMESTAMP
-        void gc_all(const uint64_t timestamp) {
+#if defined(ENABLE_TIMESTAMP) && defined(ENABLE_GC)
+        /// Drops the versions older than timestamp of the vertices written since they were last collected
+        ///
+        /// The calling thread and the threads of workers take GC_SLICE dirty vertices at a time and lock
+        /// one vertex at a time, so a writer never waits for more than one vertex and the index stays
+        /// unlocked. Vertices written after timestamp keep versions a later pass has to drop and stay dirty.
+        void gc_all(const uint64_t timestamp, WorkerPool &workers) {
             if (timestamp == prev_timestamp) return;
-            container::RequiredLock index_lock{container::config::VERTEX_INDEX_LOCK_IDX, true};
-            vertex_index->lock(index_lock);
-            for (uint64_t i = 0; i < m_vertex_count; i++) {
-                container::RequiredLock lock{i, true};
-                vertex_index->lock(lock);
-            
-                auto ptr = vertex_index->get_entry(i);
-                ptr->gc(timestamp);
-
-                auto neighbor_ptr = vertex_index->get_neighbor_ptr(i);
-                auto it = neighbor_ptr->get_begin(timestamp, ptr->get_lock(), false);
-                while(it.is_valid()) {
-                    it->gc(timestamp);
-                    ++it;
+            std::vector<std::pair<uint64_t, uint64_t>> dirty;
+            m_dirty.take(dirty);
+
+            const uint64_t slice = std::max<uint64_t>(container::config::GC_SLICE, 1);
+            std::atomic<uint64_t> next {0};
+            auto worker = [&] {
+                for (uint64_t begin; (begin = next.fetch_add(slice)) < dirty.size(); ) {
+                    uint64_t end = std::min<uint64_t>(begin + slice, dirty.size());
+                    for (uint64_t i = begin; i < end; i++) {
+                        auto [vertex, newest] = dirty[i];
+                        gc_vertex(vertex, timestamp);
+                        if (newest > timestamp) m_dirty.add(vertex, newest);
+                    }
                 }
-            }
-            vertex_index->unlock(index_lock);
+            };
+
+            // a single slice is not worth waking the pool for
+            if (dirty.size() > slice) workers.run(worker);
+            else worker();
+            prev_timestamp = timestamp;
         }
 #else
-        void gc_all(const uint64_t timestamp) {}
+        void gc_all(const uint64_t timestamp, WorkerPool &workers) {}
 #endif
 
     private:
@@ -241,5 +305,37 @@ namespace container {
 
         VertexIndex* vertex_index;
         uint64_t prev_timestamp {0};
+        SnapshotBound m_snapshot_bound;
+
+        // handed to VertexEntry::update_degree, which asks only once its degree ring is full, and to
+        // fold_delta, which asks only once the delta of the edge index has outgrown its limit
+        auto oldest_snapshot() const {
+            return [this] (uint64_t needed) -> uint64_t {
+                return m_snapshot_bound ? m_snapshot_bound(needed) : 0;
+            };
+        }
+#if defined(ENABLE_TIMESTAMP) && defined(ENABLE_GC)
+        DirtySet m_dirty;
+
+        // the vertex lock is held, so the entry cannot change under us
+        void mark_dirty(uint64_t vertex, uint64_t timestamp) {
+            m_dirty.add(vertex, timestamp);
+        }
+
+        void gc_vertex(uint64_t vertex, uint64_t timestamp) {
+            auto ptr = vertex_index->get_entry(vertex);
+            if (ptr == nullptr) return;
+            container::RequiredLock lock{vertex, true};
+            vertex_index->lock(lock);
+            ptr->gc(timestamp);
+
+            // also reclaims the tombstones no active reader can see anymore
+            ptr->gc_edges(timestamp);
+
+            vertex_index->unlock(lock);
+        }
+#else
+        void mark_dirty(uint64_t vertex, uint64_t timestamp) {}
+#endif
     };
 }
\ No newline at end of file
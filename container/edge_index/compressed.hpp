@@ -0,0 +1,608 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+#include "utils/types.hpp"
+#include "utils/config.hpp"
+#include "utils/intersect.hpp"
+#include "utils/batch.hpp"
+#include "../types/types.hpp"
+
+namespace container {
+    template<typename EdgeEntry>
+    struct CompressedIterator;
+
+    namespace varint {
+        inline void encode(std::vector<uint8_t> &out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<uint8_t>(value) | 0x80);
+                value >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        inline uint64_t decode(const uint8_t* &ptr) {
+            uint64_t value = *ptr & 0x7f;
+            uint32_t shift = 7;
+            while (*ptr++ & 0x80) {
+                value |= static_cast<uint64_t>(*ptr & 0x7f) << shift;
+                shift += 7;
+            }
+            return value;
+        }
+    }
+
+    /// Every block stores its first destination verbatim and the remaining ones as varint
+    /// gaps in the shared byte array of the index.
+    struct CompressedBlock {
+        uint64_t first;
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    /// The neighbors are split into a compressed base, which is visible to every reader and holds
+    /// no versions, and a small sorted delta of ordinary entries. A destination is never stored in
+    /// both; touching a base edge with a version moves it to the delta, and gc or an outgrown delta
+    /// folds the delta entries that every reader agrees on back into the base.
+    template<typename EdgeEntry>
+    struct CompressedEdgeIndex {
+        static constexpr uint32_t BLOCK_CAPACITY = 64;
+        // the delta is folded once it outgrows max(COMPACT_MIN_DELTA, base / COMPACT_RATIO), or twice
+        // what the last fold had to keep for open snapshots
+        static constexpr uint64_t COMPACT_MIN_DELTA = 64;
+        static constexpr uint64_t COMPACT_RATIO = 16;
+        static constexpr bool FAST_PROBE = true;
+
+        std::vector<CompressedBlock> m_blocks;
+        std::vector<uint8_t> m_bytes;
+        uint64_t m_base_num {0};
+        uint64_t m_compact_limit {COMPACT_MIN_DELTA};
+        std::vector<EdgeEntry>* m_delta;
+#ifdef ENABLE_WEIGHT
+        std::vector<double> m_base_weights;     // by ordinal in the base, weights do not compress
+        std::vector<double>* m_delta_weights;   // parallel to m_delta
+#endif
+
+        CompressedEdgeIndex() {
+            m_delta = new std::vector<EdgeEntry>();
+#ifdef ENABLE_WEIGHT
+            m_delta_weights = new std::vector<double>();
+#endif
+        }
+
+        ~CompressedEdgeIndex() = default;
+
+        bool has_edge(uint64_t src, uint64_t dest, uint64_t timestamp) const {
+            auto iter = delta_find(dest);
+            if (iter != m_delta->end() && iter->get_dest() == dest) return iter->check_version(timestamp);
+            return base_contains(dest);
+        }
+
+        double base_weight(uint64_t ordinal) const {
+#ifdef ENABLE_WEIGHT
+            return m_base_weights[ordinal];
+#else
+            return 0.0;
+#endif
+        }
+
+        double delta_weight(uint64_t idx) const {
+#ifdef ENABLE_WEIGHT
+            return (*m_delta_weights)[idx];
+#else
+            return 0.0;
+#endif
+        }
+
+        // NaN if the edge is not visible at timestamp
+        double get_weight(uint64_t dest, uint64_t timestamp) const {
+            auto iter = delta_find(dest);
+            if (iter != m_delta->end() && iter->get_dest() == dest) {
+                if (!iter->check_version(timestamp)) return std::numeric_limits<double>::quiet_NaN();
+                return delta_weight(iter - m_delta->begin());
+            }
+            auto ordinal = base_find(dest);
+            if (ordinal == m_base_num) return std::numeric_limits<double>::quiet_NaN();
+            return base_weight(ordinal);
+        }
+
+        uint64_t intersect(const CompressedEdgeIndex<EdgeEntry> & other, uint64_t timestamp) const {
+            return intersect::neighbors(*this, other, timestamp);
+        }
+
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0) {
+            auto iter = delta_find(dest);
+            if (iter != m_delta->end() && iter->get_dest() == dest) {
+                bool revived = iter->is_deleted();
+                iter->update_version(timestamp);
+#ifdef ENABLE_WEIGHT
+                (*m_delta_weights)[iter - m_delta->begin()] = weight;
+#endif
+                return revived;
+            }
+            // a base edge is already visible to everyone, a new version would not change that
+            auto ordinal = base_find(dest);
+            if (ordinal != m_base_num) {
+#ifdef ENABLE_WEIGHT
+                m_base_weights[ordinal] = weight;
+#endif
+                return false;
+            }
+
+#ifdef ENABLE_WEIGHT
+            m_delta_weights->insert(m_delta_weights->begin() + (iter - m_delta->begin()), weight);
+#endif
+            m_delta->insert(iter, EdgeEntry{dest, timestamp});
+#ifndef ENABLE_TIMESTAMP
+            if (m_delta->size() > m_compact_limit) compact(0);
+#endif
+            return true;
+        }
+
+        bool remove_edge(uint64_t dest, uint64_t timestamp) {
+            auto iter = delta_find(dest);
+            if (iter != m_delta->end() && iter->get_dest() == dest) {
+                if (iter->is_deleted()) return false;
+#ifdef ENABLE_TIMESTAMP
+                iter->delete_version(timestamp);
+#else
+#ifdef ENABLE_WEIGHT
+                m_delta_weights->erase(m_delta_weights->begin() + (iter - m_delta->begin()));
+#endif
+                m_delta->erase(iter);
+#endif
+                return true;
+            }
+
+            double weight = 0.0;
+            if (!base_remove(dest, weight)) return false;
+#ifdef ENABLE_TIMESTAMP
+            // readers older than timestamp still see the edge through the version at 0
+#ifdef ENABLE_WEIGHT
+            m_delta_weights->insert(m_delta_weights->begin() + (iter - m_delta->begin()), weight);
+#endif
+            iter = m_delta->insert(iter, EdgeEntry{dest, 0});
+            iter->delete_version(timestamp);
+#endif
+            (void) weight;
+            return true;
+        }
+
+        uint64_t gc(uint64_t timestamp) {
+            auto size = m_delta->size();
+            uint64_t keep = 0;
+            for (uint64_t i = 0; i < size; i++) {
+                if ((*m_delta)[i].gc(timestamp)) continue;
+                if (keep != i) {
+                    (*m_delta)[keep] = std::move((*m_delta)[i]);
+#ifdef ENABLE_WEIGHT
+                    (*m_delta_weights)[keep] = (*m_delta_weights)[i];
+#endif
+                }
+                keep++;
+            }
+            m_delta->erase(m_delta->begin() + keep, m_delta->end());
+#ifdef ENABLE_WEIGHT
+            m_delta_weights->resize(keep);
+#endif
+            auto removed = size - m_delta->size();
+            compact(timestamp);
+            return removed;
+        }
+
+        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {}) {
+            if (std::is_sorted(dest_list.begin(), dest_list.end())) {
+                return insert_sorted_batch(dest_list, weight_list.empty() ? nullptr : weight_list.data(), timestamp);
+            }
+            std::vector<uint64_t> sorted_list(dest_list);
+            std::vector<double> sorted_weights(weight_list);
+            batch::sort(sorted_list, sorted_weights);
+            return insert_sorted_batch(sorted_list, sorted_weights.empty() ? nullptr : sorted_weights.data(), timestamp);
+        }
+
+        // existing delta entries are updated in place, the new ones are merged into the delta with a single pass
+        uint64_t insert_sorted_batch(const std::vector<uint64_t> &dest_list, const double* weights, uint64_t timestamp) {
+            static thread_local std::vector<uint64_t> fresh;
+            static thread_local std::vector<double> fresh_weights;
+            fresh.clear();
+            fresh_weights.clear();
+            uint64_t sum = 0;
+
+            auto pos = m_delta->begin();
+            for (uint64_t i = 0; i < dest_list.size(); i++) {
+                auto dest = dest_list[i];
+                if (i > 0 && dest == dest_list[i - 1]) continue;
+                double weight = weights ? weights[i] : 0.0;
+                pos = std::lower_bound(pos, m_delta->end(), dest, [] (const EdgeEntry &entry, uint64_t dest) {
+                    return entry.get_dest() < dest;
+                });
+                if (pos != m_delta->end() && pos->get_dest() == dest) {
+                    sum += pos->is_deleted();
+                    pos->update_version(timestamp);
+#ifdef ENABLE_WEIGHT
+                    (*m_delta_weights)[pos - m_delta->begin()] = weight;
+#endif
+                    continue;
+                }
+                auto ordinal = base_find(dest);
+                if (ordinal == m_base_num) {
+                    fresh.push_back(dest);
+                    fresh_weights.push_back(weight);
+                }
+#ifdef ENABLE_WEIGHT
+                else m_base_weights[ordinal] = weight;
+#endif
+            }
+            if (fresh.empty()) return sum;
+            sum += fresh.size();
+
+            int64_t read = m_delta->size() - 1;
+            m_delta->resize(m_delta->size() + fresh.size());
+#ifdef ENABLE_WEIGHT
+            m_delta_weights->resize(m_delta->size());
+            auto &arr_weights = *m_delta_weights;
+#endif
+            int64_t write = m_delta->size() - 1;
+            auto &arr = *m_delta;
+            for (int64_t i = fresh.size() - 1; i >= 0; write--) {
+                if (read >= 0 && arr[read].get_dest() > fresh[i]) {
+#ifdef ENABLE_WEIGHT
+                    arr_weights[write] = arr_weights[read];
+#endif
+                    arr[write] = std::move(arr[read--]);
+                } else {
+#ifdef ENABLE_WEIGHT
+                    arr_weights[write] = fresh_weights[i];
+#endif
+                    arr[write] = EdgeEntry(fresh[i--], timestamp);
+                }
+            }
+#ifndef ENABLE_TIMESTAMP
+            if (m_delta->size() > m_compact_limit) compact(0);
+#endif
+            return sum;
+        }
+
+        template<typename F>
+        uint64_t edges(F&& callback, uint64_t timestamp) const {
+            uint64_t sum = 0;
+            auto delta = m_delta->begin();
+            auto delta_end = m_delta->end();
+
+            // emits the delta entries before bound, returns false once the callback asks to stop
+            auto drain = [&] (uint64_t bound) {
+                for (; delta != delta_end && delta->get_dest() < bound; ++delta) {
+                    if (!delta->check_version(timestamp)) continue;
+                    sum += delta->get_dest();
+                    if (!callback(delta->get_dest(), delta_weight(delta - m_delta->begin()))) return false;
+                }
+                return true;
+            };
+
+            uint64_t ordinal = 0;
+            for (auto &block : m_blocks) {
+                const uint8_t* ptr = m_bytes.data() + block.offset;
+                uint64_t value = block.first;
+                for (uint32_t i = 0; i < block.count; i++, ordinal++) {
+                    if (i > 0) value += varint::decode(ptr);
+                    if (!drain(value)) return sum;
+                    sum += value;
+                    if (!callback(value, base_weight(ordinal))) return sum;
+                }
+            }
+            drain(std::numeric_limits<uint64_t>::max());
+            return sum;
+        }
+
+        void init_graph(std::vector<uint64_t> &dest, uint64_t start, uint64_t end, EdgeDriverConfig exp_cfg = EdgeDriverConfig(), std::vector<uint64_t> timestamp_arr = std::vector<uint64_t>{}) {
+            std::sort(dest.begin() + start, dest.begin() + end);
+            std::vector<uint64_t> unique;
+            for (uint64_t ptr = start; ptr < end; ptr++) {
+                if (ptr == start || dest[ptr] != dest[ptr - 1]) unique.push_back(dest[ptr]);
+            }
+            build_base(unique);
+#ifdef ENABLE_WEIGHT
+            m_base_weights.assign(unique.size(), 0.0);
+#endif
+        }
+
+        /// Versioned writes cannot fold the delta by themselves, since a reader older than timestamp may still
+        /// need the versions. The container calls this after every write; oldest_snapshot(needed) bounds the
+        /// open snapshots as in VertexEntry::update_degree and is only asked once the delta is over its limit.
+        template<typename F>
+        void fold_delta(uint64_t timestamp, F &&oldest_snapshot) {
+#ifdef ENABLE_TIMESTAMP
+            if (m_delta->size() > m_compact_limit) compact(oldest_snapshot(timestamp));
+#endif
+        }
+
+        // folds every delta entry whose newest version is live and not after timestamp into the base
+        void compact(uint64_t timestamp) {
+            static thread_local std::vector<uint64_t> folded;
+            static thread_local std::vector<double> folded_weights;
+            static thread_local std::vector<uint64_t> versions;
+            folded.clear();
+            folded_weights.clear();
+            uint64_t keep = 0;
+            for (uint64_t idx = 0; idx < m_delta->size(); idx++) {
+                auto iter = m_delta->begin() + idx;
+                versions.clear();
+                iter->get_versions(&versions);
+                if (!iter->is_deleted() && version_timestamp(versions.front()) <= timestamp) {
+                    folded.push_back(iter->get_dest());
+                    folded_weights.push_back(delta_weight(idx));
+                } else {
+                    if (keep != idx) {
+                        (*m_delta)[keep] = std::move(*iter);
+#ifdef ENABLE_WEIGHT
+                        (*m_delta_weights)[keep] = (*m_delta_weights)[idx];
+#endif
+                    }
+                    ++keep;
+                }
+            }
+            m_delta->erase(m_delta->begin() + keep, m_delta->end());
+#ifdef ENABLE_WEIGHT
+            m_delta_weights->resize(keep);
+#endif
+            if (folded.empty()) return update_compact_limit();
+
+            static thread_local std::vector<uint64_t> merged;
+            merged.clear();
+            merged.reserve(m_base_num + folded.size());
+#ifdef ENABLE_WEIGHT
+            std::vector<double> merged_weights;
+            merged_weights.reserve(m_base_num + folded.size());
+#endif
+            uint64_t fold = 0, ordinal = 0;
+            auto take_fold = [&] () {
+#ifdef ENABLE_WEIGHT
+                merged_weights.push_back(folded_weights[fold]);
+#endif
+                merged.push_back(folded[fold++]);
+            };
+            for (auto &block : m_blocks) {
+                const uint8_t* ptr = m_bytes.data() + block.offset;
+                uint64_t value = block.first;
+                for (uint32_t i = 0; i < block.count; i++, ordinal++) {
+                    if (i > 0) value += varint::decode(ptr);
+                    while (fold < folded.size() && folded[fold] < value) take_fold();
+#ifdef ENABLE_WEIGHT
+                    merged_weights.push_back(m_base_weights[ordinal]);
+#endif
+                    merged.push_back(value);
+                }
+            }
+            while (fold < folded.size()) take_fold();
+            build_base(merged);
+#ifdef ENABLE_WEIGHT
+            m_base_weights.swap(merged_weights);
+#endif
+        }
+
+        // bytes held by the base, the block directory and the delta entries
+        uint64_t size_in_bytes() const {
+            uint64_t bytes = m_bytes.capacity() + m_blocks.capacity() * sizeof(CompressedBlock) + m_delta->capacity() * sizeof(EdgeEntry);
+#ifdef ENABLE_WEIGHT
+            bytes += (m_base_weights.capacity() + m_delta_weights->capacity()) * sizeof(double);
+#endif
+            return bytes;
+        }
+
+        void clear() {
+            m_blocks.clear();
+            m_bytes.clear();
+            m_base_num = 0;
+            if (m_delta) delete m_delta;
+            m_delta = nullptr;
+#ifdef ENABLE_WEIGHT
+            m_base_weights.clear();
+            if (m_delta_weights) delete m_delta_weights;
+            m_delta_weights = nullptr;
+#endif
+        }
+
+        CompressedIterator<EdgeEntry> get_begin(uint64_t timestamp) const {
+            return CompressedIterator<EdgeEntry>(this, timestamp);
+        }
+
+        typename std::vector<EdgeEntry>::iterator delta_find(uint64_t dest) const {
+            return std::lower_bound(m_delta->begin(), m_delta->end(), dest, [] (const EdgeEntry &entry, uint64_t dest) {
+                return entry.get_dest() < dest;
+            });
+        }
+
+        // the block whose range may hold dest, or m_blocks.size() if dest precedes every block
+        uint64_t find_block(uint64_t dest) const {
+            auto iter = std::upper_bound(m_blocks.begin(), m_blocks.end(), dest, [] (uint64_t dest, const CompressedBlock &block) {
+                return dest < block.first;
+            });
+            if (iter == m_blocks.begin()) return m_blocks.size();
+            return iter - m_blocks.begin() - 1;
+        }
+
+        bool base_contains(uint64_t dest) const {
+            auto id = find_block(dest);
+            if (id == m_blocks.size()) return false;
+            auto &block = m_blocks[id];
+            const uint8_t* ptr = m_bytes.data() + block.offset;
+            uint64_t value = block.first;
+            for (uint32_t i = 1; i < block.count && value < dest; i++) value += varint::decode(ptr);
+            return value == dest;
+        }
+
+        // the ordinal of dest in the base, or m_base_num if it is not there; only needed to reach the base weights
+        uint64_t base_find(uint64_t dest) const {
+#ifdef ENABLE_WEIGHT
+            auto id = find_block(dest);
+            if (id == m_blocks.size()) return m_base_num;
+            auto &block = m_blocks[id];
+            const uint8_t* ptr = m_bytes.data() + block.offset;
+            uint64_t value = block.first;
+            uint32_t i = 0;
+            while (value < dest && ++i < block.count) value += varint::decode(ptr);
+            if (value != dest) return m_base_num;
+            uint64_t ordinal = i;
+            for (uint64_t b = 0; b < id; b++) ordinal += m_blocks[b].count;
+            return ordinal;
+#else
+            return base_contains(dest) ? 0 : m_base_num;
+#endif
+        }
+
+        // re-encodes the block holding dest without it; the gaps only ever merge, so the block never grows
+        bool base_remove(uint64_t dest, double &weight) {
+            auto id = find_block(dest);
+            if (id == m_blocks.size()) return false;
+            auto &block = m_blocks[id];
+
+            static thread_local std::vector<uint64_t> values;
+            values.clear();
+            const uint8_t* ptr = m_bytes.data() + block.offset;
+            uint64_t value = block.first;
+            for (uint32_t i = 0; i < block.count; i++) {
+                if (i > 0) value += varint::decode(ptr);
+                values.push_back(value);
+            }
+            auto iter = std::lower_bound(values.begin(), values.end(), dest);
+            if (iter == values.end() || *iter != dest) return false;
+#ifdef ENABLE_WEIGHT
+            uint64_t ordinal = iter - values.begin();
+            for (uint64_t b = 0; b < id; b++) ordinal += m_blocks[b].count;
+            weight = m_base_weights[ordinal];
+            m_base_weights.erase(m_base_weights.begin() + ordinal);
+#endif
+            values.erase(iter);
+
+            uint32_t old_end = id + 1 < m_blocks.size() ? m_blocks[id + 1].offset : m_bytes.size();
+            uint32_t old_size = old_end - block.offset;
+            static thread_local std::vector<uint8_t> encoded;
+            encoded.clear();
+            for (uint64_t i = 1; i < values.size(); i++) varint::encode(encoded, values[i] - values[i - 1]);
+
+            std::copy(encoded.begin(), encoded.end(), m_bytes.begin() + block.offset);
+            uint32_t slack = old_size - encoded.size();
+            m_bytes.erase(m_bytes.begin() + block.offset + encoded.size(), m_bytes.begin() + old_end);
+            for (uint64_t i = id + 1; i < m_blocks.size(); i++) m_blocks[i].offset -= slack;
+
+            if (values.empty()) {
+                m_blocks.erase(m_blocks.begin() + id);
+            } else {
+                block.first = values.front();
+                block.count = values.size();
+            }
+            m_base_num--;
+            return true;
+        }
+
+        // dests must be sorted and free of duplicates
+        void build_base(const std::vector<uint64_t> &dests) {
+            m_blocks.clear();
+            m_bytes.clear();
+            m_base_num = dests.size();
+            for (uint64_t i = 0; i < dests.size(); i += BLOCK_CAPACITY) {
+                uint32_t count = std::min<uint64_t>(BLOCK_CAPACITY, dests.size() - i);
+                m_blocks.push_back(CompressedBlock{dests[i], static_cast<uint32_t>(m_bytes.size()), count});
+                for (uint32_t j = 1; j < count; j++) varint::encode(m_bytes, dests[i + j] - dests[i + j - 1]);
+            }
+            m_blocks.shrink_to_fit();
+            m_bytes.shrink_to_fit();
+            update_compact_limit();
+        }
+
+        // entries pinned by an old snapshot must not make every following write scan them again
+        void update_compact_limit() {
+            m_compact_limit = std::max({COMPACT_MIN_DELTA, m_base_num / COMPACT_RATIO, 2 * static_cast<uint64_t>(m_delta->size())});
+        }
+    };
+
+    /// Walks the base and the delta side by side; base edges are decoded on the fly and
+    /// exposed through an entry materialized in the iterator.
+    template<typename EdgeEntry>
+    struct CompressedIterator {
+        const CompressedEdgeIndex<EdgeEntry>* index;
+        uint64_t timestamp;
+        uint64_t block_id {0};
+        uint32_t pos_in_block {0};
+        const uint8_t* ptr {nullptr};
+        uint64_t base_value {0};
+        typename std::vector<EdgeEntry>::iterator delta;
+        EdgeEntry base_entry;
+        EdgeEntry* current {nullptr};
+
+        CompressedIterator(const CompressedEdgeIndex<EdgeEntry>* index, uint64_t ts)
+            : index(index), timestamp(ts), delta(index->m_delta->begin()) {
+            if (!index->m_blocks.empty()) {
+                ptr = index->m_bytes.data() + index->m_blocks[0].offset;
+                base_value = index->m_blocks[0].first;
+            }
+            skip_invisible();
+            select();
+        }
+
+        CompressedIterator(const CompressedIterator &other)
+            : index(other.index), timestamp(other.timestamp), block_id(other.block_id), pos_in_block(other.pos_in_block),
+              ptr(other.ptr), base_value(other.base_value), delta(other.delta), base_entry(other.base_entry.get_dest()) {
+            current = other.current == &other.base_entry ? &base_entry : other.current;
+        }
+
+        bool valid() {
+            return current != nullptr;
+        }
+
+        CompressedIterator& operator++() {
+            if (current == &base_entry) advance_base();
+            else if (current != nullptr) {
+                ++delta;
+                skip_invisible();
+            }
+            select();
+            return (*this);
+        }
+
+        EdgeEntry* operator->() {
+            return current;
+        }
+
+        EdgeEntry& operator*() {
+            return *current;
+        }
+
+    private:
+        bool base_valid() const {
+            return block_id < index->m_blocks.size();
+        }
+
+        void advance_base() {
+            auto &block = index->m_blocks[block_id];
+            if (++pos_in_block < block.count) {
+                base_value += varint::decode(ptr);
+                return;
+            }
+            pos_in_block = 0;
+            if (++block_id < index->m_blocks.size()) {
+                ptr = index->m_bytes.data() + index->m_blocks[block_id].offset;
+                base_value = index->m_blocks[block_id].first;
+            }
+        }
+
+        void skip_invisible() {
+            while (delta != index->m_delta->end() && !delta->check_version(timestamp)) ++delta;
+        }
+
+        void select() {
+            bool has_delta = delta != index->m_delta->end();
+            if (base_valid() && (!has_delta || base_value < delta->get_dest())) {
+                base_entry = EdgeEntry(base_value);
+                current = &base_entry;
+            } else {
+                current = has_delta ? &(*delta) : nullptr;
+            }
+        }
+    };
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include "utils/dense_map.hpp"
+
+#include "utils/types.hpp"
+#include "utils/config.hpp"
+#include "utils/intersect.hpp"
+#include "utils/batch.hpp"
+#include "../types/types.hpp"
+
+namespace container {
+    template<typename EdgeEntry>
+    struct HashmapEdgeIterator;
+
+    /// Open-addressing map from destination to entry; membership is a single probe, the entries
+    /// themselves live densely in the map so scans stay sequential but come out unordered.
+    template<typename EdgeEntry>
+    struct HashmapEdgeIndex {
+        using map_t = ankerl::unordered_dense::map<uint64_t, EdgeEntry>;
+        static constexpr bool FAST_PROBE = true;
+
+        map_t* m_map;
+#ifdef ENABLE_WEIGHT
+        // parallel to the dense value array of m_map, erase moves the last slot into the hole
+        std::vector<double>* m_weights;
+#endif
+
+        HashmapEdgeIndex() {
+            // inlined into a caller that builds the map right away, GCC 12 loses track of the
+            // bucket count and flags the memset in the map's clear_buckets()
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstringop-overflow"
+#endif
+            m_map = new map_t();
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#ifdef ENABLE_WEIGHT
+            m_weights = new std::vector<double>();
+#endif
+        }
+
+        ~HashmapEdgeIndex() = default;
+
+        bool has_edge(uint64_t src, uint64_t dest, uint64_t timestamp) const {
+            auto iter = m_map->find(dest);
+            return iter != m_map->end() && iter->second.check_version(timestamp);
+        }
+
+        double weight_at(size_t idx) const {
+#ifdef ENABLE_WEIGHT
+            return (*m_weights)[idx];
+#else
+            return 0.0;
+#endif
+        }
+
+        // NaN if the edge is not visible at timestamp
+        double get_weight(uint64_t dest, uint64_t timestamp) const {
+            auto iter = m_map->find(dest);
+            if (iter == m_map->end() || !iter->second.check_version(timestamp)) return std::numeric_limits<double>::quiet_NaN();
+            return weight_at(iter - m_map->begin());
+        }
+
+        // probes the larger neighborhood with every visible edge of the smaller one
+        uint64_t intersect(const HashmapEdgeIndex<EdgeEntry> & other, uint64_t timestamp) const {
+            auto small = m_map, large = other.m_map;
+            if (small->size() > large->size()) std::swap(small, large);
+            uint64_t sum = 0;
+            for (auto &[dest, entry] : *small) {
+                if (!entry.check_version(timestamp)) continue;
+                auto iter = large->find(dest);
+                if (iter != large->end() && iter->second.check_version(timestamp)) sum++;
+            }
+            return sum;
+        }
+
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0) {
+            auto [iter, inserted] = m_map->try_emplace(dest, dest, timestamp);
+#ifdef ENABLE_WEIGHT
+            // one unversioned slot per edge, a re-insert overwrites it like in the other indexes
+            if (inserted) m_weights->push_back(weight);
+            else (*m_weights)[iter - m_map->begin()] = weight;
+#endif
+            if (inserted) return true;
+            bool revived = iter->second.is_deleted();
+            iter->second.update_version(timestamp);
+            return revived;
+        }
+
+        bool remove_edge(uint64_t dest, uint64_t timestamp) {
+            auto iter = m_map->find(dest);
+            if (iter == m_map->end() || iter->second.is_deleted()) return false;
+#ifdef ENABLE_TIMESTAMP
+            iter->second.delete_version(timestamp);
+#else
+            erase(iter);
+#endif
+            return true;
+        }
+
+        uint64_t gc(uint64_t timestamp) {
+#ifdef ENABLE_WEIGHT
+            uint64_t sum = 0;
+            for (auto iter = m_map->begin(); iter != m_map->end();) {
+                if (iter->second.gc(timestamp)) {
+                    // the last entry moves into this slot, look at it again
+                    erase(iter);
+                    sum++;
+                } else {
+                    ++iter;
+                }
+            }
+            return sum;
+#else
+            return std::erase_if(*m_map, [timestamp] (auto &pair) {
+                return pair.second.gc(timestamp);
+            });
+#endif
+        }
+
+        // the batch needs no ordering, duplicates simply find the entry inserted before them
+        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {}) {
+            m_map->reserve(m_map->size() + dest_list.size());
+            uint64_t sum = 0;
+            for (size_t i = 0; i < dest_list.size(); i++) sum += insert_edge(dest_list[i], timestamp, weight_list.empty() ? 0.0 : weight_list[i]);
+            return sum;
+        }
+
+        template<typename F>
+        uint64_t edges(F&& callback, uint64_t timestamp) const {
+            uint64_t sum = 0;
+            for (auto iter = m_map->begin(); iter != m_map->end(); ++iter) {
+                if (__builtin_expect(iter->second.check_version(timestamp), 1)) {
+                    bool should_continue = callback(iter->first, weight_at(iter - m_map->begin()));
+                    sum += iter->first;
+                    if (!should_continue) break;
+                }
+            }
+            return sum;
+        }
+
+        void init_graph(std::vector<uint64_t> &dest, uint64_t start, uint64_t end, EdgeDriverConfig exp_cfg = EdgeDriverConfig(), std::vector<uint64_t> timestamp_arr = std::vector<uint64_t>{}) {
+            m_map->reserve(end - start);
+            for (uint64_t ptr = start; ptr < end; ptr++) {
+                m_map->try_emplace(dest[ptr], dest[ptr], ptr);
+            }
+#ifdef ENABLE_WEIGHT
+            m_weights->resize(m_map->size(), 0.0);
+#endif
+        }
+
+        void clear() {
+            if (m_map) delete m_map;
+            m_map = nullptr;
+#ifdef ENABLE_WEIGHT
+            if (m_weights) delete m_weights;
+            m_weights = nullptr;
+#endif
+        }
+
+    private:
+        // ankerl erases by moving the last value into the hole, the weight column follows suit
+        void erase(typename map_t::iterator iter) {
+#ifdef ENABLE_WEIGHT
+            size_t idx = iter - m_map->begin();
+            (*m_weights)[idx] = m_weights->back();
+            m_weights->pop_back();
+#endif
+            m_map->erase(iter);
+        }
+
+    public:
+
+        HashmapEdgeIterator<EdgeEntry> get_begin(uint64_t timestamp) const {
+            HashmapEdgeIterator<EdgeEntry> it(m_map->begin(), m_map, timestamp);
+            if (it.valid() && !it->check_version(timestamp)) ++it;
+            return it;
+        }
+    };
+
+    template<typename EdgeEntry>
+    struct HashmapEdgeIterator {
+        typename HashmapEdgeIndex<EdgeEntry>::map_t::iterator it;
+        typename HashmapEdgeIndex<EdgeEntry>::map_t* iter_map;
+        uint64_t timestamp;
+
+        HashmapEdgeIterator(typename HashmapEdgeIndex<EdgeEntry>::map_t::iterator iter, typename HashmapEdgeIndex<EdgeEntry>::map_t* map, uint64_t ts)
+            : it(iter), iter_map(map), timestamp(ts) {}
+
+        bool valid() {
+            return (it != iter_map->end());
+        }
+
+        HashmapEdgeIterator& operator++() {
+            do {
+                ++it;
+            } while (valid() && !it->second.check_version(timestamp));
+            return (*this);
+        }
+
+        EdgeEntry* operator->() {
+            return &(it->second);
+        }
+
+        EdgeEntry& operator*() {
+            return it->second;
+        }
+    };
+}
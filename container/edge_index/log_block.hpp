@@ -11,6 +11,7 @@
 #include "utils/types.hpp"
 #include "types/types.hpp"
 #include "utils/config.hpp"
+#include "utils/intersect.hpp"
 
 namespace container {
     template<typename EdgeEntry>
@@ -25,22 +26,101 @@ namespace container {
         return lg2;
     }
 
+    // The logs are kept as a base run sorted by dest, followed by a tail in append order.
+    // Once the tail outgrows its bound it is sorted and merged into the base.
     template<typename EdgeEntry>
     struct LogBlockEdgeIndex {
+        // the tail is compacted once it is longer than both of these
+        static constexpr size_t COMPACT_MIN_TAIL = 64;
+        static constexpr size_t COMPACT_RATIO = 128;  // or the base divided by this
+
         std::vector<EdgeEntry>* m_block;
+#ifdef ENABLE_WEIGHT
+        std::vector<double>* m_weights;   // weight of the log at the same position in m_block
+#endif
         SimdBlockFilterFixed<>* m_filter;  
         size_t m_log_num;
+        size_t m_base_num;      // logs [0, m_base_num) are sorted by dest, the logs of one dest in append order
         LogBlockEdgeIndex() {
             m_filter = new SimdBlockFilterFixed<>(16);
             m_block = new std::vector<EdgeEntry>(0);
             m_block->reserve(16);
+#ifdef ENABLE_WEIGHT
+            m_weights = new std::vector<double>(0);
+            m_weights->reserve(16);
+#endif
             m_log_num = 0;
+            m_base_num = 0;
         }
         ~LogBlockEdgeIndex() {
             delete m_block;
+#ifdef ENABLE_WEIGHT
+            delete m_weights;
+#endif
             delete m_filter;
         }
+
+        double weight_at(size_t idx) const {
+#ifdef ENABLE_WEIGHT
+            return (*m_weights)[idx];
+#else
+            return 0.0;
+#endif
+        }
     
+        // the logs of dest in the base run
+        std::pair<EdgeEntry*, EdgeEntry*> base_range(uint64_t dest) const {
+            auto begin = m_block->data(), end = m_block->data() + m_base_num;
+            begin = std::lower_bound(begin, end, dest, [] (const EdgeEntry &entry, uint64_t value) {
+                return entry.get_dest() < value;
+            });
+            end = std::upper_bound(begin, end, dest, [] (uint64_t value, const EdgeEntry &entry) {
+                return value < entry.get_dest();
+            });
+            return {begin, end};
+        }
+
+        // the open log of dest, searched from the newest
+        EdgeEntry* find_newest(uint64_t dest, uint64_t timestamp) {
+            for (size_t idx = m_log_num; idx > m_base_num; idx--) {
+                auto &cur_log = (*m_block)[idx - 1];
+                if (cur_log.get_dest() == dest && cur_log.check_is_newest(timestamp)) return &cur_log;
+            }
+            auto [begin, end] = base_range(dest);
+            for (auto iter = end; iter != begin; iter--) {
+                if ((iter - 1)->check_is_newest(timestamp)) return iter - 1;
+            }
+            return nullptr;
+        }
+
+        // sorts the tail and merges it into the base, the logs of a dest stay in the order they were appended
+        void compact() {
+#ifdef ENABLE_WEIGHT
+            // the weights have to follow their logs, sort the two columns zipped together
+            std::vector<std::pair<EdgeEntry, double>> logs;
+            logs.reserve(m_log_num);
+            for (size_t i = 0; i < m_log_num; i++) logs.emplace_back(std::move((*m_block)[i]), (*m_weights)[i]);
+            auto begin = logs.begin(), middle = begin + m_base_num, end = begin + m_log_num;
+            auto by_dest = [] (const std::pair<EdgeEntry, double> &a, const std::pair<EdgeEntry, double> &b) {
+                return a.first.get_dest() < b.first.get_dest();
+            };
+            std::stable_sort(middle, end, by_dest);
+            std::inplace_merge(begin, middle, end, by_dest);
+            for (size_t i = 0; i < m_log_num; i++) {
+                (*m_block)[i] = std::move(logs[i].first);
+                (*m_weights)[i] = logs[i].second;
+            }
+#else
+            auto begin = m_block->begin(), middle = begin + m_base_num, end = begin + m_log_num;
+            auto by_dest = [] (const EdgeEntry &a, const EdgeEntry &b) {
+                return a.get_dest() < b.get_dest();
+            };
+            std::stable_sort(middle, end, by_dest);
+            std::inplace_merge(begin, middle, end, by_dest);
+#endif
+            m_base_num = m_log_num;
+        }
+
         bool has_edge(uint64_t src, uint64_t dest, uint64_t timestamp) {
             if (m_log_num == 0) {
                 return false;
@@ -50,37 +130,59 @@ namespace container {
                 return false;
             }
             
-            auto iter = m_block->end() - 1;
-            for (int64_t idx = 0; idx < m_log_num; idx++) {
-                if (iter->get_dest() == dest && iter->check_version(timestamp)) {
+            for (size_t idx = m_log_num; idx > m_base_num; idx--) {
+                auto &cur_log = (*m_block)[idx - 1];
+                if (cur_log.get_dest() == dest && cur_log.check_version(timestamp)) {
                     return true;
                 }
-                iter--;
+            }
+            auto [begin, end] = base_range(dest);
+            for (auto iter = begin; iter != end; iter++) {
+                if (iter->check_version(timestamp)) return true;
             }
 
             return false;
         }
 
-        bool insert_edge(uint64_t dest, uint64_t timestamp) {
+        // every log keeps the weight it was written with, NaN if no log of dest is visible at timestamp
+        double get_weight(uint64_t dest, uint64_t timestamp) const {
+            if (m_log_num == 0 || !m_filter->Find(dest)) return std::numeric_limits<double>::quiet_NaN();
+            for (size_t idx = m_log_num; idx > m_base_num; idx--) {
+                auto &cur_log = (*m_block)[idx - 1];
+                if (cur_log.get_dest() == dest && cur_log.check_version(timestamp)) return weight_at(idx - 1);
+            }
+            auto [begin, end] = base_range(dest);
+            for (auto iter = begin; iter != end; iter++) {
+                if (iter->check_version(timestamp)) return weight_at(iter - m_block->data());
+            }
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0) {
             auto entry = EdgeEntry{dest, timestamp};
 
             // update old logs
             bool new_edge_flag = true;
             if(m_filter->Find(dest)) {
-                // printf("%ld, %ld\n", hit, m_log_num);
-                for (int64_t idx = m_log_num - 1; idx > 0; idx--) {
-                    auto &cur_log = (*m_block)[idx];
-                    if (cur_log.get_dest() == dest && cur_log.check_is_newest(timestamp)) {
-                        cur_log.update_version(timestamp);
-                        new_edge_flag = false;
-                        break;
-                    }
-
+                auto cur_log = find_newest(dest, timestamp);
+                if (cur_log) {
+                    cur_log->update_version(timestamp);
+                    new_edge_flag = false;
+#if defined(ENABLE_WEIGHT) && !defined(ENABLE_TIMESTAMP)
+                    (*m_weights)[cur_log - m_block->data()] = weight;
+#endif
                 }
             }
+#ifndef ENABLE_TIMESTAMP
+            // without versions the existing log already stands for the edge
+            if (!new_edge_flag) return false;
+#endif
             m_filter->Add(dest);
     
             m_block->push_back(entry);
+#ifdef ENABLE_WEIGHT
+            m_weights->push_back(weight);
+#endif
             m_log_num++;
             int log_size = log2(m_log_num);
             if (log_size > 4 && (log_size % 4 == 0) && (1 << log_size) == m_log_num) {
@@ -90,30 +192,99 @@ namespace container {
                     m_filter->Add((*m_block)[i].get_dest());
                 }
             }
+            if (m_log_num - m_base_num > std::max(COMPACT_MIN_TAIL, m_base_num / COMPACT_RATIO)) compact();
             return new_edge_flag;
         }
 
-        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp) {
+        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {}) {
             uint64_t sum = 0;
-            for (auto & dest : dest_list) {
-                sum += insert_edge(dest, timestamp);
+            for (size_t i = 0; i < dest_list.size(); i++) {
+                sum += insert_edge(dest_list[i], timestamp, weight_list.empty() ? 0.0 : weight_list[i]);
             }
             return sum;
         }
 
+        bool remove_edge(uint64_t dest, uint64_t timestamp) {
+            if (m_log_num == 0 || !m_filter->Find(dest)) return false;
+#ifdef ENABLE_TIMESTAMP
+            // close the newest log of dest, later readers no longer see it
+            auto cur_log = find_newest(dest, timestamp);
+            if (!cur_log) return false;
+            cur_log->delete_version(timestamp);
+            return true;
+#else
+            // without versions every dest has a single log
+            auto [begin, end] = base_range(dest);
+            if (begin == end) {
+                auto tail = m_block->begin() + m_base_num;
+                auto iter = std::find_if(tail, m_block->end(), [dest] (const EdgeEntry &entry) {
+                    return entry.get_dest() == dest;
+                });
+                if (iter == m_block->end()) return false;
+                erase(iter - m_block->begin());
+            } else {
+                erase(begin - m_block->data());
+                m_base_num--;
+            }
+            m_log_num = m_block->size();
+            return true;
+#endif
+        }
+
+        void erase(size_t idx) {
+            m_block->erase(m_block->begin() + idx);
+#ifdef ENABLE_WEIGHT
+            m_weights->erase(m_weights->begin() + idx);
+#endif
+        }
+
+        // drops the logs ended before timestamp, folds the tail into the base and rebuilds the filter
+        uint64_t gc(uint64_t timestamp) {
+            auto size = m_log_num;
+            size_t cur = 0, base_num = 0;
+            for (size_t i = 0; i < m_log_num; i++) {
+                if ((*m_block)[i].gc(timestamp)) continue;
+                if (cur != i) {
+                    (*m_block)[cur] = std::move((*m_block)[i]);
+#ifdef ENABLE_WEIGHT
+                    (*m_weights)[cur] = (*m_weights)[i];
+#endif
+                }
+                if (i < m_base_num) base_num++;
+                cur++;
+            }
+            m_base_num = base_num;
+            m_block->erase(m_block->begin() + cur, m_block->end());
+#ifdef ENABLE_WEIGHT
+            m_weights->resize(cur);
+#endif
+            m_log_num = m_block->size();
+            compact();
+
+            if (m_log_num != size) {
+                delete m_filter;
+                m_filter = new SimdBlockFilterFixed<>(std::max<size_t>(m_log_num, 16));
+                for (uint64_t i = 0; i < m_log_num; i++) {
+                    m_filter->Add((*m_block)[i].get_dest());
+                }
+            }
+            return size - m_log_num;
+        }
+
+        // the base comes out in ascending order, followed by the tail
         template<typename F>
         uint64_t edges(F&& callback, uint64_t timestamp) const {
             auto size = m_log_num;
             auto block_ptr = m_block;
             uint64_t ret = 0;
-            auto iter = block_ptr->end() - 1;
+            auto iter = block_ptr->begin();
     
             for (int64_t idx = 0; idx < size; idx++) {
                 if (__builtin_expect(iter->check_version(timestamp), 1)) {
-                    callback(iter->get_dest(), 0.0); // NOTE: Do not support weight now
+                    callback(iter->get_dest(), weight_at(idx));
                     ret += iter->get_dest();
                 }
-                iter--;
+                iter++;
             }
             return ret;
         }
@@ -122,13 +293,21 @@ namespace container {
         void clear() {
             if (m_block) delete m_block;
             m_block = nullptr;
+#ifdef ENABLE_WEIGHT
+            if (m_weights) delete m_weights;
+            m_weights = nullptr;
+#endif
         }
 
         LogBlockIterator<EdgeEntry> get_begin(uint64_t timestamp) const {
-            return LogBlockIterator<EdgeEntry>(m_block->begin(), m_block, timestamp);
+            LogBlockIterator<EdgeEntry> it(m_block->begin(), m_block, timestamp);
+            if (it.valid() && !it->check_version(timestamp)) ++it;
+            return it;
         }
 
-        uint64_t intersect(const LogBlockEdgeIndex &, uint64_t timestamp) const {return 0;}
+        uint64_t intersect(const LogBlockEdgeIndex & other, uint64_t timestamp) const {
+            return intersect::neighbors(*this, other, timestamp);
+        }
 
     };
 
@@ -9,8 +9,11 @@
 #include <chrono>
 #include <cstring>
 #include <immintrin.h>
+#include <tbb/parallel_for.h>
 
 #include "utils/types.hpp"
+#include "utils/intersect.hpp"
+#include "utils/batch.hpp"
 #include "utils/unordered_dense/include/ankerl/unordered_dense.h"
 #include "types/types.hpp"
 
@@ -37,9 +40,16 @@ namespace container {
         // PMA
         std::vector<EdgeEntry> impl;
         std::vector<uint64_t> sizes;
+#ifdef ENABLE_WEIGHT
+        // weight of impl[i] at weights[i], moved together with the entries
+        std::vector<double> weights;
+#endif
         // std::vector<EdgeEntry> tmp;
         // std::vector<char> exist;
         
+        // windows holding at least this many entries are redistributed by several threads
+        static constexpr uint64_t PARALLEL_REBALANCE_THRESHOLD = 1 << 16;
+
         uint64_t element_num;     // number of elements in the pma
         uint64_t segment_size;
         uint64_t segment_num;
@@ -53,6 +63,9 @@ namespace container {
         /// Returns the upper threshold for the given level. The upper threshold limits the number of elements in a segment.
         double upper_threshold_at(uint64_t level) const;
 
+        /// Returns the lower threshold for the given level. Windows below it are merged with their neighbours, and the array shrinks once the root is below it.
+        double lower_threshold_at(uint64_t level) const;
+
         void init_vars(uint64_t capacity);
 
         /// Returns the left boundary of the interval that contains the element at index 'i'.
@@ -60,9 +73,12 @@ namespace container {
         /// left_interval_boundary(54, 8) returns 48
         static uint64_t left_interval_boundary(uint64_t i, uint64_t interval_size);
 
-        /// Grow the array to the given capacity.
+        /// Grow or shrink the array to the given capacity.
         void resize(int capacity);
 
+        /// Halve the array until the root is above its lower threshold.
+        void shrink();
+
         /// Check if the interval start at 'left' is within limits. And count the number of elements in the interval.
         void get_interval_stats(uint64_t left, uint64_t level, bool &in_limit, uint64_t &sz);
 
@@ -74,12 +90,49 @@ namespace container {
         uint64_t lower_bound(uint64_t dest);
 
 
+        /// @return the weight stored with impl[idx], 0 without ENABLE_WEIGHT
+        double weight_at(uint64_t idx) const;
+
         /// @return true if insert a new entry, false if insert a version
-        bool insert_merge(uint64_t left, uint64_t dest, uint64_t timestamp);
+        bool insert_merge(uint64_t left, uint64_t dest, uint64_t timestamp, double weight);
 
         void rebalance_interval(uint64_t left, uint64_t level);
 
-        bool insert(uint64_t dest, uint64_t timestamp);
+        bool insert(uint64_t dest, uint64_t timestamp, double weight = 0.0);
+
+        /// The destinations of a batch that land in one segment, as a range of the new ones.
+        struct BatchRun {
+            uint64_t segment;
+            uint64_t begin;
+            uint64_t end;
+        };
+
+        /// Insert a sorted batch with a single pass: every overflowing window is redistributed once, and the array grows at most once.
+        /// @param weights the weights of dests, may be null
+        /// @return the number of entries that became visible
+        uint64_t insert_batch(const uint64_t* dests, const double* weights, uint64_t num, uint64_t timestamp);
+
+        /// Merge new destinations into segment 'segment_id', which must have room for them.
+        void merge_segment(uint64_t segment_id, const uint64_t* fresh, const double* fresh_weights, uint64_t num, uint64_t timestamp);
+
+        /// Move the entries of segments [first, first + count) into 'out', merged with the new destinations, and their weights into 'out_weights'.
+        void gather(uint64_t first, uint64_t count, const uint64_t* fresh, const double* fresh_weights, uint64_t num, uint64_t timestamp,
+                    std::vector<EdgeEntry> &out, std::vector<double> &out_weights);
+
+        /// Distribute 'buffer' (and 'buffer_weights') evenly over segments [first, first + count).
+        void spread(std::vector<EdgeEntry> &buffer, std::vector<double> &buffer_weights, uint64_t first, uint64_t count);
+
+        /// @return true if a visible entry is deleted
+        bool remove(uint64_t dest, uint64_t timestamp);
+
+        /// Rebalance the smallest window around 'segment_id' that is above the lower threshold, after an entry was removed from it.
+        void rebalance_underflow(uint64_t segment_id);
+
+        /// Compact the segments, dropping the entries reclaimed by their version gc.
+        uint64_t gc(uint64_t timestamp);
+
+        /// Rebalance every window left below the lower threshold by a compaction, each once, or shrink the array.
+        void rebalance_underflows();
 
         PMAIterator<EdgeEntry> begin(uint64_t);
 
@@ -118,7 +171,8 @@ namespace container {
         PMAIterator& operator++() {
             do {
                 element_id++;
-                if (element_id == m_leaf->sizes[block_id]) {
+                // deletions may leave empty segments behind
+                while (block_id < m_leaf->segment_num && element_id >= m_leaf->sizes[block_id]) {
                     block_id++;
                     element_id = 0;
                 }
@@ -155,6 +209,8 @@ namespace container {
 
     template<typename EdgeEntry>
     struct PMAIndex {
+        static constexpr bool FAST_PROBE = true;
+
         RWSpinLock index_lock{};
         std::vector<RequiredLock> required_locks{};
         PMALeaf<EdgeEntry>* m_leaf;
@@ -165,12 +221,30 @@ namespace container {
         
         bool has_edge(uint64_t src, uint64_t dest, uint64_t timestamp);
 
+        // NaN if the edge is not visible at timestamp
+        double get_weight(uint64_t dest, uint64_t timestamp) const;
+
+        template<typename F>
+        uint64_t edges(F&& callback, uint64_t timestamp) const;
+
+        // visits every stored entry in order with its weight, whatever its versions
         template<typename F>
-        uint64_t edges(F&& callback, uint64_t timestamp);
+        void for_each_entry(F&& callback) {
+            for (uint64_t i = 0; i < m_leaf->segment_num; i++) {
+                for (uint64_t j = 0; j < m_leaf->sizes[i]; j++) {
+                    uint64_t idx = i * m_leaf->segment_size + j;
+                    callback(m_leaf->impl[idx], m_leaf->weight_at(idx));
+                }
+            }
+        }
+
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0);
 
-        bool insert_edge(uint64_t dest, uint64_t timestamp);
+        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {});
 
-        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp);
+        bool remove_edge(uint64_t dest, uint64_t timestamp);
+
+        uint64_t gc(uint64_t timestamp);
 
         uint64_t init_graph(std::vector<uint64_t> &dest, uint64_t start, uint64_t end, EdgeDriverConfig exp_cfg);
 
@@ -199,6 +273,9 @@ namespace container {
         this->init_vars(capacity);
         this->impl.resize(capacity);
         this->sizes.resize(this->segment_num, 0);
+#ifdef ENABLE_WEIGHT
+        this->weights.resize(capacity, 0.0);
+#endif
     }
 
     /// Returns the upper threshold for the given level. The upper threshold limits the number of elements in a segment.
@@ -209,6 +286,13 @@ namespace container {
         return threshold;
     }
 
+    template<typename EdgeEntry>
+    double PMALeaf<EdgeEntry>::lower_threshold_at(uint64_t level) const {
+        assert(level <= this->level_num);
+        double threshold = 0.125 + ((0.25 - 0.125) * level) / (double) this->lgn;
+        return threshold;
+    }
+
     template<typename EdgeEntry>
     void PMALeaf<EdgeEntry>::init_vars(uint64_t capacity) {
         assert(this->segment_size == (1 << log2(this->segment_size)));
@@ -229,42 +313,37 @@ namespace container {
         return boundary;
     }
 
-    /// Grow the array to the given capacity.
+    /// Grow or shrink the array to the given capacity.
     template<typename EdgeEntry>
     void PMALeaf<EdgeEntry>::resize(int capacity) {
-        assert(capacity > this->impl.size());
+        assert(capacity >= this->element_num && capacity >= this->segment_size);
         assert(1 << log2(capacity) == capacity);
-        uint64_t new_segment_num = capacity / this->segment_size;
 
-        std::vector<EdgeEntry> tmp_buffer(this->element_num);
-        uint64_t tmp_size = 0;
-        
-        for (uint64_t i = 0; i < this->segment_num; i++) {
-            for (uint64_t j = 0; j < this->sizes[i]; j++) {
-                tmp_buffer[tmp_size++] = std::move(this->impl[i * segment_size + j]);
-            }
-        }
-        assert(tmp_size == this->element_num);
+        std::vector<EdgeEntry> tmp_buffer;
+        std::vector<double> tmp_weights;
+        gather(0, this->segment_num, nullptr, nullptr, 0, 0, tmp_buffer, tmp_weights);
+        assert(tmp_buffer.size() == this->element_num);
 
         std::vector<EdgeEntry> new_impl(capacity);
-        std::vector<uint64_t> new_sizes(new_segment_num);
-
-        uint64_t tmp_idx = 0;
-        uint64_t average_size = (tmp_size + new_segment_num - 1) / new_segment_num;
-
-        for (uint64_t i = 0; i < new_segment_num; i++) {
-            uint64_t j = 0;
-            uint64_t remain_size = std::min(average_size, tmp_size - tmp_idx);
-            for (j = 0; j < remain_size; j++) {
-                new_impl[i * segment_size + j] = std::move(tmp_buffer[tmp_idx++]);
-            }
-            new_sizes[i] = j;
-        }
-        assert(tmp_idx == this->element_num);
-
         this->impl.swap(new_impl);
-        this->sizes.swap(new_sizes);
+#ifdef ENABLE_WEIGHT
+        this->weights.assign(capacity, 0.0);
+#endif
         this->init_vars(capacity);
+        this->sizes.assign(this->segment_num, 0);
+        spread(tmp_buffer, tmp_weights, 0, this->segment_num);
+    }
+
+    template<typename EdgeEntry>
+    void PMALeaf<EdgeEntry>::shrink() {
+        uint64_t capacity = this->impl.size();
+        while (capacity > segment_size) {
+            uint64_t levels = log2(capacity / segment_size);
+            double t = 0.125 + ((0.25 - 0.125) * levels) / (double) log2(capacity);
+            if ((double) this->element_num / double(capacity) >= t) break;
+            capacity /= 2;
+        }
+        if (capacity < this->impl.size()) this->resize(capacity);
     }
 
     /// Check if the interval start at 'left' is within limits. And count the number of elements in the interval.
@@ -307,26 +386,39 @@ namespace container {
 
         while (l <= r) {
             m = l + (r - l) / 2;
-            // TODO: remove left_interval_boundary
-            uint64_t left = left_interval_boundary(m * segment_size, segment_size);
-            // uint64_t left = m * segment_size;
-            int pos = lb_in_segment(left, dest);
+            // empty segments carry no keys, probe the closest non-empty one on the left instead
+            int k = m;
+            while (k >= l && this->sizes[k] == 0) k--;
+            if (k < l) {
+                l = m + 1;
+                continue;
+            }
+            int pos = lb_in_segment(k * segment_size, dest);
 
             if (pos == 1) { // find in the right side
                 l = m + 1;
             } else if (pos == -1) { // find in the left side
-                r = m - 1;
+                r = k - 1;
             } else {
-                return m * segment_size;
+                return k * segment_size;
             }
         }
         return l * segment_size;
     }
 
 
+    template<typename EdgeEntry>
+    inline double PMALeaf<EdgeEntry>::weight_at(uint64_t idx) const {
+#ifdef ENABLE_WEIGHT
+        return this->weights[idx];
+#else
+        return 0.0;
+#endif
+    }
+
     /// @return true if insert a new entry, false if insert a version
     template<typename EdgeEntry>
-    bool PMALeaf<EdgeEntry>::insert_merge(uint64_t left, uint64_t dest, uint64_t timestamp) {
+    bool PMALeaf<EdgeEntry>::insert_merge(uint64_t left, uint64_t dest, uint64_t timestamp, double weight) {
         uint64_t segment_id = left / segment_size;
         uint64_t cur_segment_size = sizes[segment_id];
         assert(cur_segment_size < segment_size);
@@ -334,52 +426,42 @@ namespace container {
 
         EdgeEntry value(dest);
         auto iter = std::lower_bound(segment_begin, segment_begin + cur_segment_size, value);
+        uint64_t offset = std::distance(segment_begin, iter);
         bool insert_entry_flag = false;
         if (iter != segment_begin + cur_segment_size && iter->get_dest() == dest) {
+            insert_entry_flag = iter->is_deleted();
             iter->update_version(timestamp);
         } else {
             if (iter == segment_begin + cur_segment_size) {
                 this->impl[left + cur_segment_size] = EdgeEntry(dest, timestamp);
             } else {
-                uint64_t offset = std::distance(segment_begin, iter);
                 std::move_backward(segment_begin + offset, segment_begin + cur_segment_size, segment_begin + cur_segment_size + 1);
                 *iter = EdgeEntry(dest, timestamp);
+#ifdef ENABLE_WEIGHT
+                auto weight_begin = this->weights.begin() + left;
+                std::copy_backward(weight_begin + offset, weight_begin + cur_segment_size, weight_begin + cur_segment_size + 1);
+#endif
             }
             ++this->element_num;
             ++this->sizes[segment_id];
             insert_entry_flag = true;
         }
+#ifdef ENABLE_WEIGHT
+        this->weights[left + offset] = weight;
+#endif
         return insert_entry_flag;
     }
 
     template<typename EdgeEntry>
     void PMALeaf<EdgeEntry>::rebalance_interval(uint64_t left, uint64_t level) {
-        uint64_t w = (1 << level) * this->segment_size;
-        std::vector<EdgeEntry> tmp_buffer(w);
-        size_t tmp_size = 0;
-        
-        for (uint64_t i = left; i < left + w; i += segment_size) {
-            for (uint64_t j = 0; j < this->sizes[i / this->segment_size]; j++) {
-                tmp_buffer[tmp_size++] = std::move(this->impl[i + j]);
-            }
-        }
-
-        size_t average_size = (tmp_size + (1 << level) - 1) / (1 << level);
-        size_t tmp_idx = 0;
-        
-        for (uint64_t i = left; i < left + w; i += segment_size) {
-            uint64_t j = 0;
-            uint64_t remain_size = std::min(average_size, tmp_size - tmp_idx);
-            for (j = 0; j < remain_size; j++) {
-                this->impl[i + j] = std::move(tmp_buffer[tmp_idx++]);
-            }
-            this->sizes[i / this->segment_size] = j;
-        }
-        assert(tmp_idx == tmp_size);
+        std::vector<EdgeEntry> tmp_buffer;
+        std::vector<double> tmp_weights;
+        gather(left / segment_size, 1 << level, nullptr, nullptr, 0, 0, tmp_buffer, tmp_weights);
+        spread(tmp_buffer, tmp_weights, left / segment_size, 1 << level);
     }
 
     template<typename EdgeEntry>
-    bool PMALeaf<EdgeEntry>::insert(uint64_t dest, uint64_t timestamp) {
+    bool PMALeaf<EdgeEntry>::insert(uint64_t dest, uint64_t timestamp, double weight) {
         uint64_t i = lower_bound(dest);
         if (i == this->impl.size()) {
             --i;
@@ -401,7 +483,7 @@ namespace container {
         // be unused (with significant probability). First check that
         // as a quick check.
         if (this->sizes[idx] < segment_size) {
-            return this->insert_merge(l, dest, timestamp);
+            return this->insert_merge(l, dest, timestamp, weight);
         } else {
             // No space in this interval. Find an interval above this
             // interval that is within limits, re-balance, and
@@ -413,14 +495,320 @@ namespace container {
                 if (level > this->level_num) {
                     // Root node is out of balance. Resize array.
                     this->resize(2 * this->impl.size());
-                    return this->insert(dest, timestamp);
+                    return this->insert(dest, timestamp, weight);
                 }
 
                 l = left_interval_boundary(i, w);
                 get_interval_stats(l, level, in_limit, sz);
             }
             this->rebalance_interval(l, level);
-            return this->insert(dest, timestamp);
+            return this->insert(dest, timestamp, weight);
+        }
+    }
+
+    template<typename EdgeEntry>
+    uint64_t PMALeaf<EdgeEntry>::insert_batch(const uint64_t* dests, const double* weights_in, uint64_t num, uint64_t timestamp) {
+        static thread_local std::vector<uint64_t> fresh;
+        static thread_local std::vector<double> fresh_weights;
+        static thread_local std::vector<BatchRun> runs;
+        fresh.clear();
+        fresh_weights.clear();
+        runs.clear();
+
+        // a batch with a destination every few segments walks the segments forward instead of searching for each run
+        bool dense = num * 8 >= this->segment_num;
+        uint64_t sum = 0;
+        uint64_t pos = 0, s = 0;
+
+        // route each run of destinations to its segment, existing entries are updated in place and the new ones
+        // are merged right away if the segment has room, the others are kept, grouped by segment
+        while (pos < num) {
+            if (!dense) s = lower_bound(dests[pos]) / segment_size;
+            while (s < this->segment_num && (this->sizes[s] == 0 || this->impl[s * segment_size + this->sizes[s] - 1].get_dest() < dests[pos])) s++;
+            bool append = s == this->segment_num;
+            if (append) {
+                // larger than every entry, they all go to the last non-empty segment
+                while (s > 0 && this->sizes[s - 1] == 0) s--;
+                s = s ? s - 1 : 0;
+            }
+            if (runs.empty() || runs.back().segment != s) runs.push_back({s, fresh.size(), fresh.size()});
+
+            auto segment_begin = this->impl.begin() + s * segment_size;
+            auto segment_end = segment_begin + this->sizes[s];
+            auto iter = segment_begin;
+            while (pos < num && (append || dests[pos] <= (segment_end - 1)->get_dest())) {
+                uint64_t dest = dests[pos++];
+                if (pos > 1 && dest == dests[pos - 2]) continue;
+                double weight = weights_in ? weights_in[pos - 1] : 0.0;
+                iter = std::lower_bound(iter, segment_end, EdgeEntry(dest));
+                if (iter != segment_end && iter->get_dest() == dest) {
+                    sum += iter->is_deleted();
+                    iter->update_version(timestamp);
+#ifdef ENABLE_WEIGHT
+                    this->weights[iter - this->impl.begin()] = weight;
+#endif
+                } else {
+                    fresh.push_back(dest);
+                    fresh_weights.push_back(weight);
+                }
+            }
+            auto & run = runs.back();
+            run.end = fresh.size();
+            uint64_t count = run.end - run.begin;
+            if (this->sizes[s] + count <= segment_size) {
+                merge_segment(s, fresh.data() + run.begin, fresh_weights.data() + run.begin, count, timestamp);
+                this->element_num += count;
+                sum += count;
+                fresh.resize(run.begin);
+                fresh_weights.resize(run.begin);
+                runs.pop_back();
+            }
+        }
+        if (fresh.empty()) return sum;
+
+        auto run_at = [] (uint64_t segment) {
+            return std::lower_bound(runs.begin(), runs.end(), segment, [] (const BatchRun &run, uint64_t s) {
+                return run.segment < s;
+            }) - runs.begin();
+        };
+        auto run_begin = [] (uint64_t r) {
+            return r < runs.size() ? runs[r].begin : fresh.size();
+        };
+
+        // every segment left with a run is covered by the smallest window within limits,
+        // nested windows collapse into the outer one
+        std::vector<std::pair<uint64_t, uint64_t>> windows;
+        bool grow = false;
+        for (uint64_t r = 0; r < runs.size() && !grow; r++) {
+            uint64_t s = runs[r].segment;
+            if (!windows.empty() && s < windows.back().first + windows.back().second) continue;
+
+            grow = true;
+            for (uint64_t level = 1; level <= this->level_num; level++) {
+                uint64_t count = 1 << level;
+                uint64_t first = left_interval_boundary(s, count);
+                uint64_t sz = run_begin(run_at(first + count)) - run_begin(run_at(first));
+                for (uint64_t i = first; i < first + count; i++) sz += this->sizes[i];
+                if ((double) sz / double(count * segment_size) < upper_threshold_at(level)) {
+                    while (!windows.empty() && windows.back().first >= first) windows.pop_back();
+                    windows.emplace_back(first, count);
+                    grow = false;
+                    break;
+                }
+            }
+        }
+
+        std::vector<EdgeEntry> buffer;
+        std::vector<double> buffer_weights;
+        if (grow) {
+            // the root is out of balance, double until the whole array is within limits and rebuild once
+            uint64_t total = this->element_num + fresh.size();
+            uint64_t capacity = this->impl.size();
+            while (true) {
+                capacity *= 2;
+                uint64_t levels = log2(capacity / segment_size);
+                double t = 1.0 - ((1.0 - 0.5) * levels) / (double) log2(capacity);
+                if (levels == 0 ? total <= capacity : (double) total / double(capacity) < t) break;
+            }
+            gather(0, this->segment_num, fresh.data(), fresh_weights.data(), fresh.size(), timestamp, buffer, buffer_weights);
+            std::vector<EdgeEntry> new_impl(capacity);
+            this->impl.swap(new_impl);
+#ifdef ENABLE_WEIGHT
+            this->weights.assign(capacity, 0.0);
+#endif
+            this->init_vars(capacity);
+            this->sizes.assign(this->segment_num, 0);
+            spread(buffer, buffer_weights, 0, this->segment_num);
+        } else {
+            for (auto [first, count] : windows) {
+                uint64_t lo = run_begin(run_at(first));
+                uint64_t hi = run_begin(run_at(first + count));
+                gather(first, count, fresh.data() + lo, fresh_weights.data() + lo, hi - lo, timestamp, buffer, buffer_weights);
+                spread(buffer, buffer_weights, first, count);
+            }
+        }
+        this->element_num += fresh.size();
+        return sum + fresh.size();
+    }
+
+    template<typename EdgeEntry>
+    void PMALeaf<EdgeEntry>::merge_segment(uint64_t segment_id, const uint64_t* fresh, const double* fresh_weights, uint64_t num, uint64_t timestamp) {
+        uint64_t left = segment_id * segment_size;
+        uint64_t i = this->sizes[segment_id], j = num, k = i + num;
+        assert(k <= segment_size);
+        while (j > 0) {
+            if (i > 0 && this->impl[left + i - 1].get_dest() > fresh[j - 1]) {
+                --k;
+                --i;
+                this->impl[left + k] = std::move(this->impl[left + i]);
+#ifdef ENABLE_WEIGHT
+                this->weights[left + k] = this->weights[left + i];
+#endif
+            } else {
+                --k;
+                --j;
+                this->impl[left + k] = EdgeEntry(fresh[j], timestamp);
+#ifdef ENABLE_WEIGHT
+                this->weights[left + k] = fresh_weights[j];
+#endif
+            }
+        }
+        this->sizes[segment_id] += num;
+    }
+
+    template<typename EdgeEntry>
+    void PMALeaf<EdgeEntry>::gather(uint64_t first, uint64_t count, const uint64_t* fresh, const double* fresh_weights, uint64_t num, uint64_t timestamp,
+                                    std::vector<EdgeEntry> &out, std::vector<double> &out_weights) {
+        out.clear();
+        out_weights.clear();
+        uint64_t j = 0;
+        auto take_fresh = [&] () {
+#ifdef ENABLE_WEIGHT
+            out_weights.push_back(fresh_weights[j]);
+#endif
+            out.emplace_back(fresh[j++], timestamp);
+        };
+        for (uint64_t s = first; s < first + count; s++) {
+            uint64_t left = s * segment_size;
+            for (uint64_t i = 0; i < this->sizes[s]; i++) {
+                auto & entry = this->impl[left + i];
+                while (j < num && fresh[j] < entry.get_dest()) take_fresh();
+#ifdef ENABLE_WEIGHT
+                out_weights.push_back(this->weights[left + i]);
+#endif
+                out.push_back(std::move(entry));
+            }
+        }
+        while (j < num) take_fresh();
+    }
+
+    template<typename EdgeEntry>
+    void PMALeaf<EdgeEntry>::spread(std::vector<EdgeEntry> &buffer, std::vector<double> &buffer_weights, uint64_t first, uint64_t count) {
+        uint64_t total = buffer.size();
+        assert((total + count - 1) / count <= segment_size);
+
+        // segment sizes differ by at most one, so no run of empty segments is left at the end of the window
+        auto place = [&] (uint64_t i) {
+            uint64_t lo = i * total / count;
+            uint64_t hi = (i + 1) * total / count;
+            uint64_t left = (first + i) * segment_size;
+            for (uint64_t j = lo; j < hi; j++) {
+                this->impl[left + j - lo] = std::move(buffer[j]);
+            }
+#ifdef ENABLE_WEIGHT
+            std::copy(buffer_weights.begin() + lo, buffer_weights.begin() + hi, this->weights.begin() + left);
+#endif
+            this->sizes[first + i] = hi - lo;
+        };
+        if (total >= PARALLEL_REBALANCE_THRESHOLD) {
+            tbb::parallel_for(uint64_t(0), count, place);
+        } else {
+            for (uint64_t i = 0; i < count; i++) place(i);
+        }
+    }
+
+    template<typename EdgeEntry>
+    bool PMALeaf<EdgeEntry>::remove(uint64_t dest, uint64_t timestamp) {
+        uint64_t i = lower_bound(dest);
+        if (i == this->impl.size()) return false;
+
+        uint64_t segment_id = i / segment_size;
+        auto segment_begin = this->impl.begin() + segment_id * segment_size;
+        auto segment_end = segment_begin + this->sizes[segment_id];
+
+        EdgeEntry value(dest);
+        auto iter = std::lower_bound(segment_begin, segment_end, value);
+        if (iter == segment_end || iter->get_dest() != dest || iter->is_deleted()) return false;
+#ifdef ENABLE_TIMESTAMP
+        iter->delete_version(timestamp);
+#else
+#ifdef ENABLE_WEIGHT
+        auto weight_iter = this->weights.begin() + (iter - this->impl.begin());
+        std::copy(weight_iter + 1, weight_iter + (segment_end - iter), weight_iter);
+#endif
+        std::move(iter + 1, segment_end, iter);
+        --this->sizes[segment_id];
+        --this->element_num;
+        rebalance_underflow(segment_id);
+#endif
+        return true;
+    }
+
+    template<typename EdgeEntry>
+    void PMALeaf<EdgeEntry>::rebalance_underflow(uint64_t segment_id) {
+        if (this->level_num == 0 || (double) this->sizes[segment_id] / double(segment_size) >= lower_threshold_at(0)) return;
+
+        for (uint64_t level = 1; level <= this->level_num; level++) {
+            uint64_t count = 1 << level;
+            uint64_t first = left_interval_boundary(segment_id, count);
+            uint64_t sz = 0;
+            for (uint64_t i = first; i < first + count; i++) sz += this->sizes[i];
+            if ((double) sz / double(count * segment_size) >= lower_threshold_at(level)) {
+                rebalance_interval(first * segment_size, level);
+                return;
+            }
+        }
+        // Root node is below its lower threshold. Shrink array.
+        shrink();
+    }
+
+    template<typename EdgeEntry>
+    uint64_t PMALeaf<EdgeEntry>::gc(uint64_t timestamp) {
+        uint64_t reclaimed = 0;
+        for (uint64_t i = 0; i < this->segment_num; i++) {
+            uint64_t left = i * segment_size;
+            uint64_t cur = 0;
+            for (uint64_t j = 0; j < this->sizes[i]; j++) {
+                if (this->impl[left + j].gc(timestamp)) continue;
+                if (cur != j) {
+                    this->impl[left + cur] = std::move(this->impl[left + j]);
+#ifdef ENABLE_WEIGHT
+                    this->weights[left + cur] = this->weights[left + j];
+#endif
+                }
+                cur++;
+            }
+            for (uint64_t j = cur; j < this->sizes[i]; j++) this->impl[left + j] = EdgeEntry();
+            reclaimed += this->sizes[i] - cur;
+            this->sizes[i] = cur;
+        }
+        this->element_num -= reclaimed;
+        if (reclaimed) rebalance_underflows();
+        return reclaimed;
+    }
+
+    template<typename EdgeEntry>
+    void PMALeaf<EdgeEntry>::rebalance_underflows() {
+        if (this->level_num == 0) return;
+        if ((double) this->element_num / double(this->impl.size()) < lower_threshold_at(this->level_num)) {
+            shrink();
+            return;
+        }
+
+        // same as insert_batch, nested windows collapse into the outer one
+        std::vector<std::pair<uint64_t, uint64_t>> windows;
+        for (uint64_t s = 0; s < this->segment_num; s++) {
+            if (!windows.empty() && s < windows.back().first + windows.back().second) continue;
+            if ((double) this->sizes[s] / double(segment_size) >= lower_threshold_at(0)) continue;
+
+            for (uint64_t level = 1; level <= this->level_num; level++) {
+                uint64_t count = 1 << level;
+                uint64_t first = left_interval_boundary(s, count);
+                uint64_t sz = 0;
+                for (uint64_t i = first; i < first + count; i++) sz += this->sizes[i];
+                if ((double) sz / double(count * segment_size) >= lower_threshold_at(level)) {
+                    while (!windows.empty() && windows.back().first >= first) windows.pop_back();
+                    windows.emplace_back(first, count);
+                    break;
+                }
+            }
+        }
+
+        std::vector<EdgeEntry> buffer;
+        std::vector<double> buffer_weights;
+        for (auto [first, count] : windows) {
+            gather(first, count, nullptr, nullptr, 0, 0, buffer, buffer_weights);
+            spread(buffer, buffer_weights, first, count);
         }
     }
 
@@ -431,7 +819,9 @@ namespace container {
 
     template<typename EdgeEntry>
     PMAIterator<EdgeEntry> PMALeaf<EdgeEntry>::begin(uint64_t timestamp) {
-        return PMAIterator(this, timestamp);
+        PMAIterator<EdgeEntry> it(this, timestamp);
+        if (!it.valid() || !it->check_version(timestamp)) ++it;
+        return it;
     }
 
     // void PMALeaf::print() {
@@ -455,6 +845,9 @@ namespace container {
     void PMALeaf<EdgeEntry>::clear() {
         impl.clear();
         sizes.clear();
+#ifdef ENABLE_WEIGHT
+        weights.clear();
+#endif
     }
 
     template<typename EdgeEntry>
@@ -477,41 +870,38 @@ namespace container {
         if (i == m_leaf->impl.size()) 
             return false;
         
-        int left = m_leaf->left_interval_boundary(i, m_leaf->segment_size);
-        int right = left + m_leaf->sizes[left / m_leaf->segment_size] - 1;
+        uint64_t left = m_leaf->left_interval_boundary(i, m_leaf->segment_size);
+        auto end = m_leaf->impl.begin() + left + m_leaf->sizes[left / m_leaf->segment_size];
 
         EdgeEntry value(dest);
-        auto pos = std::lower_bound(m_leaf->impl.begin() + left, m_leaf->impl.begin() + right, value);
-        if (pos != m_leaf->impl.end() && pos->get_dest() == dest) {
+        auto pos = std::lower_bound(m_leaf->impl.begin() + left, end, value);
+        if (pos != end && pos->get_dest() == dest) {
             return (pos->check_version(timestamp));
         }
         return false;
     }
 
+    template<typename EdgeEntry>
+    double PMAIndex<EdgeEntry>::get_weight(uint64_t dest, uint64_t timestamp) const {
+        uint64_t i = m_leaf->lower_bound(dest);
+        if (i == m_leaf->impl.size()) return std::numeric_limits<double>::quiet_NaN();
+
+        uint64_t left = m_leaf->left_interval_boundary(i, m_leaf->segment_size);
+        auto begin = m_leaf->impl.begin() + left;
+        auto end = begin + m_leaf->sizes[left / m_leaf->segment_size];
+        auto pos = std::lower_bound(begin, end, EdgeEntry(dest));
+        if (pos != end && pos->get_dest() == dest && pos->check_version(timestamp)) return m_leaf->weight_at(pos - m_leaf->impl.begin());
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
     template<typename EdgeEntry>
     uint64_t PMAIndex<EdgeEntry>::intersect(const PMAIndex<EdgeEntry> & other, uint64_t timestamp) const {
-        auto neighbor_a = m_leaf;
-        auto neighbor_b = other.m_leaf;
-        
-        uint64_t sum = 0;
-        auto iter_a = neighbor_a->begin(timestamp);
-        auto iter_b = neighbor_b->begin(timestamp);
-        // TODO: add optimization
-        while (iter_a.valid() && iter_b.valid()) {
-            if (iter_a->get_dest() < iter_b->get_dest()) ++iter_a;
-            else if (iter_a->get_dest() > iter_b->get_dest()) ++iter_b;
-            else {
-                sum++;
-                ++iter_a;
-                ++iter_b;
-            }
-        }
-        return sum;
+        return intersect::neighbors(*this, other, timestamp);
     }
 
     template<typename EdgeEntry>
     template<typename F>
-    uint64_t PMAIndex<EdgeEntry>::edges(F &&callback, uint64_t timestamp) {
+    uint64_t PMAIndex<EdgeEntry>::edges(F &&callback, uint64_t timestamp) const {
         uint64_t scan_sum = 0;
 
         for (uint64_t i = 0; i < m_leaf->segment_num; i++) {
@@ -519,7 +909,7 @@ namespace container {
             for (uint64_t j = 0; j < size; j++) {
                 auto & entry = m_leaf->impl[i * m_leaf->segment_size + j];
                 if (__builtin_expect(entry.check_version(timestamp), 1)) {
-                    bool should_continue = callback(entry.get_dest(), 0.0);
+                    bool should_continue = callback(entry.get_dest(), m_leaf->weight_at(i * m_leaf->segment_size + j));
                     scan_sum += entry.get_dest();
                     if (!should_continue) 
                         return scan_sum;
@@ -531,17 +921,29 @@ namespace container {
 
     // Insert to last leaf if the neighbor does not exist, otherwise insert to the leaf where the neighbor exists
     template<typename EdgeEntry>
-    bool PMAIndex<EdgeEntry>::insert_edge(uint64_t dest, uint64_t timestamp) {
-        return m_leaf->insert(dest, timestamp);
+    bool PMAIndex<EdgeEntry>::insert_edge(uint64_t dest, uint64_t timestamp, double weight) {
+        return m_leaf->insert(dest, timestamp, weight);
     }
 
     template<typename EdgeEntry>
-    uint64_t PMAIndex<EdgeEntry>::insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp) {
-        uint64_t sum = 0;
-        for (auto & dest : dest_list) {
-            sum += this->insert_edge(dest, timestamp);
+    uint64_t PMAIndex<EdgeEntry>::insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list) {
+        if (std::is_sorted(dest_list.begin(), dest_list.end())) {
+            return m_leaf->insert_batch(dest_list.data(), weight_list.empty() ? nullptr : weight_list.data(), dest_list.size(), timestamp);
         }
-        return sum;
+        std::vector<uint64_t> sorted_list(dest_list);
+        std::vector<double> sorted_weights(weight_list);
+        batch::sort(sorted_list, sorted_weights);
+        return m_leaf->insert_batch(sorted_list.data(), sorted_weights.empty() ? nullptr : sorted_weights.data(), sorted_list.size(), timestamp);
+    }
+
+    template<typename EdgeEntry>
+    bool PMAIndex<EdgeEntry>::remove_edge(uint64_t dest, uint64_t timestamp) {
+        return m_leaf->remove(dest, timestamp);
+    }
+
+    template<typename EdgeEntry>
+    uint64_t PMAIndex<EdgeEntry>::gc(uint64_t timestamp) {
+        return m_leaf->gc(timestamp);
     }
 
     // only for edge test use, should be moved
@@ -563,6 +965,9 @@ namespace container {
         m_leaf->init_vars(capacity);
         m_leaf->impl.resize(capacity);
         m_leaf->sizes.resize(m_leaf->segment_num, 0);
+#ifdef ENABLE_WEIGHT
+        m_leaf->weights.resize(capacity, 0.0);
+#endif
 
         uint64_t tmp_idx = 0;
         uint64_t average_size = (tmp_size + m_leaf->segment_num - 1) / m_leaf->segment_num;
@@ -9,12 +9,16 @@
 
 #include "utils/types.hpp"
 #include "utils/config.hpp"
+#include "utils/intersect.hpp"
+#include "utils/batch.hpp"
 #include "../types/types.hpp"
 #include "skiplist/skiplist.hpp"
 
 namespace container {
     template<typename EdgeEntry>
     struct SkipListEdgeIndex {
+        static constexpr bool FAST_PROBE = true;
+
         SkipList<EdgeEntry>* m_skiplist;
 
         SkipListEdgeIndex(uint64_t block_size = container::config::BLOCK_SIZE) {
@@ -29,37 +33,35 @@ namespace container {
             return m_skiplist->has_edge(dest, timestamp);
         }
 
+        double get_weight(uint64_t dest, uint64_t timestamp) const {
+            return m_skiplist->get_weight(dest, timestamp);
+        }
+
         uint64_t intersect(const SkipListEdgeIndex<EdgeEntry> & other, uint64_t timestamp) const {
-            uint64_t sum = 0;
-            auto neighbor_a = m_skiplist;
-            auto iter_a = neighbor_a->begin(timestamp);
-            auto neighbor_b = other.m_skiplist;
-            auto iter_b = neighbor_b->begin(timestamp);
-
-            // TODO: add optimization
-            while (iter_a.valid() && iter_b.valid()) {
-                if (iter_a->get_dest() < iter_b->get_dest()) ++iter_a;
-                else if (iter_a->get_dest() > iter_b->get_dest()) ++iter_b;
-                else {
-                    sum++;
-                    ++iter_a;
-                    ++iter_b;
-                }
-            }
-            return sum;
+            return intersect::neighbors(*this, other, timestamp);
         }
 
 
-        bool insert_edge(uint64_t dest, uint64_t timestamp) {
-            return m_skiplist->insert_edge(dest, timestamp);
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0) {
+            return m_skiplist->insert_edge(dest, timestamp, weight);
         }
 
-        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp) {
-            uint64_t sum = 0;
-            for (auto & dest : dest_list) {
-                sum += insert_edge(dest, timestamp);
+        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {}) {
+            if (std::is_sorted(dest_list.begin(), dest_list.end())) {
+                return m_skiplist->insert_edge_batch(dest_list.data(), weight_list.empty() ? nullptr : weight_list.data(), dest_list.size(), timestamp);
             }
-            return sum;
+            std::vector<uint64_t> sorted_list(dest_list);
+            std::vector<double> sorted_weights(weight_list);
+            batch::sort(sorted_list, sorted_weights);
+            return m_skiplist->insert_edge_batch(sorted_list.data(), sorted_weights.empty() ? nullptr : sorted_weights.data(), sorted_list.size(), timestamp);
+        }
+
+        bool remove_edge(uint64_t dest, uint64_t timestamp) {
+            return m_skiplist->remove_edge(dest, timestamp);
+        }
+
+        uint64_t gc(uint64_t timestamp) {
+            return m_skiplist->gc(timestamp);
         }
 
         template<typename F>
@@ -67,7 +69,7 @@ namespace container {
             uint64_t sum = 0;
             auto iter = m_skiplist->begin(timestamp);
             while (iter.valid()) {
-                bool should_continue = callback(iter->get_dest(), 0.0); // NOTE: Do not support weight now
+                bool should_continue = callback(iter->get_dest(), iter.weight());
                 sum += iter->get_dest();
                 iter++;
                 if (!should_continue) break;
@@ -76,6 +78,11 @@ namespace container {
         }
 
 
+        template<typename F>
+        void for_each_entry(F&& callback) {
+            m_skiplist->for_each_entry(callback);
+        }
+
         void clear() {
             if (m_skiplist) delete m_skiplist;
             m_skiplist = nullptr;
@@ -1,53 +1,401 @@
 #pragma once
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <new>
+#include <limits>
+#include <algorithm>
 #include <stdexcept>
+#include <mutex>
 
 namespace container {
 #define SKIP_LIST_LEVELS 6
+#define CACHE_LINE_SIZE 64
 
+    /// Slab for skip list blocks. Blocks of one size are carved out of 64KB chunks that keep their
+    /// own free list, and a chunk goes back to the system once all of its blocks are free again. A
+    /// thread keeps a few free blocks of each size to itself and only visits the shared pool of that
+    /// size every few allocations or frees, so blocks freed by another thread (gc, a writer of
+    /// another vertex) are reused by everyone. Blocks too large for a chunk come from operator new.
+    class BlockSlab {
+        static constexpr size_t CHUNK_SIZE = 1 << 16;
+        static constexpr size_t CACHED = 8;         // free blocks a thread keeps per size
+
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        // the first cache line of every chunk, its blocks follow
+        struct alignas(CACHE_LINE_SIZE) Chunk {
+            FreeBlock* free_list;
+            size_t live;            // blocks handed out
+            Chunk* prev;            // neighbours in the list of chunks with free blocks
+            Chunk* next;
+        };
+
+        static constexpr size_t MAX_BLOCK = CHUNK_SIZE - sizeof(Chunk);
+
+        // the chunks of one block size
+        struct Pool {
+            const size_t bytes;
+            std::mutex mutex;
+            Chunk* partial = nullptr;       // chunks with a free block
+
+            explicit Pool(size_t bytes) : bytes(bytes) {}
+
+            void take(void** blocks, size_t count) {
+                std::lock_guard<std::mutex> guard(mutex);
+                for (size_t i = 0; i < count; i++) {
+                    if (partial == nullptr) link(new_chunk());
+                    auto chunk = partial;
+                    blocks[i] = chunk->free_list;
+                    chunk->free_list = chunk->free_list->next;
+                    chunk->live++;
+                    if (chunk->free_list == nullptr) unlink(chunk);
+                }
+            }
+
+            void give(void* const* blocks, size_t count) {
+                std::lock_guard<std::mutex> guard(mutex);
+                for (size_t i = 0; i < count; i++) {
+                    auto chunk = reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(blocks[i]) & ~(CHUNK_SIZE - 1));
+                    if (chunk->free_list == nullptr) link(chunk);
+                    auto block = static_cast<FreeBlock*>(blocks[i]);
+                    block->next = chunk->free_list;
+                    chunk->free_list = block;
+                    // an empty chunk is kept only while no other one has a free block
+                    if (--chunk->live == 0 && (partial != chunk || chunk->next != nullptr)) {
+                        unlink(chunk);
+                        chunk->~Chunk();
+                        ::operator delete(chunk, std::align_val_t(CHUNK_SIZE));
+                    }
+                }
+            }
+
+        private:
+            Chunk* new_chunk() {
+                auto chunk = new (::operator new(CHUNK_SIZE, std::align_val_t(CHUNK_SIZE))) Chunk{nullptr, 0, nullptr, nullptr};
+                auto first = reinterpret_cast<char*>(chunk + 1);
+                for (size_t i = MAX_BLOCK / bytes; i-- > 0; ) {
+                    auto block = reinterpret_cast<FreeBlock*>(first + i * bytes);
+                    block->next = chunk->free_list;
+                    chunk->free_list = block;
+                }
+                return chunk;
+            }
+
+            void link(Chunk* chunk) {
+                chunk->prev = nullptr;
+                chunk->next = partial;
+                if (partial) partial->prev = chunk;
+                partial = chunk;
+            }
+
+            void unlink(Chunk* chunk) {
+                if (chunk->prev) chunk->prev->next = chunk->next;
+                else partial = chunk->next;
+                if (chunk->next) chunk->next->prev = chunk->prev;
+            }
+        };
+
+        // pools are never freed, a thread may hand its blocks back while the process exits
+        static Pool* pool_of(size_t bytes) {
+            static std::mutex mutex;
+            static auto pools = new std::vector<Pool*>();
+            std::lock_guard<std::mutex> guard(mutex);
+            for (auto pool : *pools) {
+                if (pool->bytes == bytes) return pool;
+            }
+            pools->push_back(new Pool(bytes));
+            return pools->back();
+        }
+
+        struct Cache {
+            Pool* pool;
+            size_t count;
+            void* blocks[CACHED];
+        };
+
+        std::vector<Cache> caches;
+
+        Cache& get_cache(size_t bytes) {
+            for (auto &cache : caches) {
+                if (cache.pool->bytes == bytes) return cache;
+            }
+            caches.push_back({pool_of(bytes), 0, {}});
+            return caches.back();
+        }
+
+    public:
+        static BlockSlab& local() {
+            static thread_local BlockSlab slab;
+            return slab;
+        }
+
+        BlockSlab() = default;
+        BlockSlab(const BlockSlab &) = delete;
+        BlockSlab &operator=(const BlockSlab &) = delete;
+
+        ~BlockSlab() {
+            for (auto &cache : caches) cache.pool->give(cache.blocks, cache.count);
+        }
+
+        void* allocate(size_t bytes) {
+            if (bytes > MAX_BLOCK) return ::operator new(bytes, std::align_val_t(CACHE_LINE_SIZE));
+            auto &cache = get_cache(bytes);
+            if (cache.count == 0) {
+                cache.pool->take(cache.blocks, CACHED / 2);
+                cache.count = CACHED / 2;
+            }
+            return cache.blocks[--cache.count];
+        }
+
+        void deallocate(void* ptr, size_t bytes) {
+            if (bytes > MAX_BLOCK) return ::operator delete(ptr, std::align_val_t(CACHE_LINE_SIZE));
+            auto &cache = get_cache(bytes);
+            if (cache.count == CACHED) {
+                cache.pool->give(cache.blocks + CACHED / 2, CACHED / 2);
+                cache.count = CACHED / 2;
+            }
+            cache.blocks[cache.count++] = ptr;
+        }
+    };
+
+    /// The header fills one cache line and the entries follow it in the same allocation,
+    /// blocks are only created and freed through create() / destroy(). With ENABLE_WEIGHT the
+    /// weights of the entries follow them as a separate column.
     template<typename EdgeEntry>
-    struct EdgeBlock {
-        EdgeBlock *before;  
-        std::vector<EdgeEntry> impl;
-        uint16_t size;  
+    struct alignas(CACHE_LINE_SIZE) EdgeBlock {
         uint64_t max;
         EdgeBlock *next_levels[SKIP_LIST_LEVELS];  
+        uint16_t size;  
+        uint16_t capacity;
 
-        EdgeBlock(uint64_t capacity = 256) : before(nullptr), size(0), max(0) {
-            impl.resize(capacity);
-            for (int i = 0; i < SKIP_LIST_LEVELS; i++) next_levels[i] = nullptr;
+        static size_t bytes(uint64_t capacity) {
+            auto bytes = sizeof(EdgeBlock) + capacity * sizeof(EdgeEntry);
+#ifdef ENABLE_WEIGHT
+            bytes += capacity * sizeof(double);
+#endif
+            return (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
         }
 
-        EdgeBlock(EdgeBlock<EdgeEntry> *bf, uint16_t sz, uint64_t mx,uint64_t capacity = 256) : before(bf), size(sz), max(mx) {
-            impl.resize(capacity);
-            for (int i = 0; i < SKIP_LIST_LEVELS; i++) next_levels[i] = nullptr;
+        static EdgeBlock* create(uint64_t capacity = 256) {
+            if (capacity > std::numeric_limits<uint16_t>::max()) {
+                throw std::runtime_error("Block size is too large for container::EdgeBlock");
+            }
+            auto block = new (BlockSlab::local().allocate(bytes(capacity))) EdgeBlock(capacity);
+            auto entries = block->entries();
+            for (uint64_t i = 0; i < capacity; i++) new (&entries[i]) EdgeEntry();
+#ifdef ENABLE_WEIGHT
+            std::fill(block->weights(), block->weights() + capacity, 0.0);
+#endif
+            return block;
+        }
+
+        static void destroy(EdgeBlock* block) {
+            auto capacity = block->capacity;
+            auto entries = block->entries();
+            for (uint64_t i = 0; i < capacity; i++) entries[i].~EdgeEntry();
+            block->~EdgeBlock();
+            BlockSlab::local().deallocate(block, bytes(capacity));
+        }
+
+        EdgeBlock(const EdgeBlock &) = delete;
+        EdgeBlock &operator=(const EdgeBlock &) = delete;
+
+        EdgeEntry* entries() {
+            return reinterpret_cast<EdgeEntry*>(this + 1);
+        }
+
+        const EdgeEntry* entries() const {
+            return reinterpret_cast<const EdgeEntry*>(this + 1);
+        }
+
+#ifdef ENABLE_WEIGHT
+        double* weights() {
+            return reinterpret_cast<double*>(entries() + capacity);
+        }
+
+        const double* weights() const {
+            return reinterpret_cast<const double*>(entries() + capacity);
+        }
+#endif
+
+        double weight_at(uint64_t idx) const {
+#ifdef ENABLE_WEIGHT
+            return weights()[idx];
+#else
+            return 0.0;
+#endif
         }
 
         void split(EdgeBlock<EdgeEntry> &other) {
+            auto impl = entries();
+            auto other_impl = other.entries();
             auto split = size / 2;
             for (uint64_t i = 0; i < split; i++) {
-                other.impl[i] = std::move(impl[i + split]);
+                other_impl[i] = std::move(impl[i + split]);
             }
+#ifdef ENABLE_WEIGHT
+            std::copy(weights() + split, weights() + 2 * split, other.weights());
+#endif
             other.size = split;
             size = size - split;
-            other.max = other.impl[other.size - 1].get_dest();
+            other.max = other_impl[other.size - 1].get_dest();
             max = impl[size - 1].get_dest();
         }
 
-        bool insert_edge(uint64_t dest, uint64_t timestamp) {
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0) {
+            auto impl = entries();
             EdgeEntry value(dest);
-            auto pos = std::lower_bound(impl.begin(), impl.begin() + size, value);
-            if (pos != impl.begin() + size && pos->get_dest() == dest) {
+            auto pos = std::lower_bound(impl, impl + size, value);
+#ifdef ENABLE_WEIGHT
+            auto weight_pos = weights() + (pos - impl);
+#endif
+            if (pos != impl + size && pos->get_dest() == dest) {
+                bool revived = pos->is_deleted();
                 pos->update_version(timestamp);
-                return false;
+#ifdef ENABLE_WEIGHT
+                *weight_pos = weight;
+#endif
+                return revived;
             } else {
-                std::move_backward(pos, impl.begin() + size, impl.begin() + size + 1);
+                std::move_backward(pos, impl + size, impl + size + 1);
                 *pos = EdgeEntry(dest, timestamp);
+#ifdef ENABLE_WEIGHT
+                std::copy_backward(weight_pos, weights() + size, weights() + size + 1);
+                *weight_pos = weight;
+#endif
                 size++;
                 max = impl[size - 1].dest;
             }
             return true;
         }
+
+        bool remove_edge(uint64_t dest, uint64_t timestamp) {
+            auto impl = entries();
+            EdgeEntry value(dest);
+            auto pos = std::lower_bound(impl, impl + size, value);
+            if (pos == impl + size || pos->get_dest() != dest || pos->is_deleted()) return false;
+#ifdef ENABLE_TIMESTAMP
+            pos->delete_version(timestamp);
+#else
+#ifdef ENABLE_WEIGHT
+            std::copy(weights() + (pos - impl) + 1, weights() + size, weights() + (pos - impl));
+#endif
+            std::move(pos + 1, impl + size, pos);
+            size--;
+            if (size) max = impl[size - 1].get_dest();
+#endif
+            return true;
+        }
+
+        // updates the entries of a sorted run that already exist and collects the other (unique) dests into fresh,
+        // together with their weights (weights may be null), returns the number of deleted entries that were revived
+        uint64_t update_existing(const uint64_t* dests, const double* weights_in, size_t num, uint64_t timestamp,
+                                 std::vector<uint64_t> &fresh, std::vector<double> &fresh_weights) {
+            auto impl = entries();
+            uint64_t revived = 0;
+            auto pos = impl;
+            for (size_t i = 0; i < num; i++) {
+                auto dest = dests[i];
+                if (i > 0 && dest == dests[i - 1]) continue;
+                pos = std::lower_bound(pos, impl + size, dest, [] (const EdgeEntry &entry, uint64_t dest) {
+                    return entry.get_dest() < dest;
+                });
+                double weight = weights_in ? weights_in[i] : 0.0;
+                if (pos != impl + size && pos->get_dest() == dest) {
+                    revived += pos->is_deleted();
+                    pos->update_version(timestamp);
+#ifdef ENABLE_WEIGHT
+                    weights()[pos - impl] = weight;
+#endif
+                } else {
+                    fresh.push_back(dest);
+                    fresh_weights.push_back(weight);
+                }
+            }
+            return revived;
+        }
+
+        // merges fresh into the block from the back, the block must have room for all of them
+        void merge_fresh(const std::vector<uint64_t> &fresh, const std::vector<double> &fresh_weights, uint64_t timestamp) {
+            auto impl = entries();
+            int64_t read = size - 1, write = size + fresh.size() - 1;
+            for (int64_t i = fresh.size() - 1; i >= 0; write--) {
+                if (read >= 0 && impl[read].get_dest() > fresh[i]) {
+#ifdef ENABLE_WEIGHT
+                    weights()[write] = weights()[read];
+#endif
+                    impl[write] = std::move(impl[read--]);
+                } else {
+#ifdef ENABLE_WEIGHT
+                    weights()[write] = fresh_weights[i];
+#endif
+                    impl[write] = EdgeEntry(fresh[i--], timestamp);
+                }
+            }
+            size += fresh.size();
+            if (size) max = impl[size - 1].get_dest();
+        }
+
+        // moves the entries merged with fresh into out (and their weights into out_weights) and leaves the block empty
+        void drain_merged(const std::vector<uint64_t> &fresh, const std::vector<double> &fresh_weights, uint64_t timestamp,
+                          std::vector<EdgeEntry> &out, std::vector<double> &out_weights) {
+            auto impl = entries();
+            out.reserve(out.size() + size + fresh.size());
+            out_weights.reserve(out_weights.size() + size + fresh.size());
+            uint64_t pos = 0;
+            for (uint64_t i = 0; i < fresh.size(); i++) {
+                while (pos < size && impl[pos].get_dest() < fresh[i]) {
+                    out_weights.push_back(weight_at(pos));
+                    out.push_back(std::move(impl[pos++]));
+                }
+                out_weights.push_back(fresh_weights[i]);
+                out.emplace_back(fresh[i], timestamp);
+            }
+            while (pos < size) {
+                out_weights.push_back(weight_at(pos));
+                out.push_back(std::move(impl[pos++]));
+            }
+            size = 0;
+        }
+
+        void assign(EdgeEntry* from, const double* from_weights, uint64_t num) {
+            auto impl = entries();
+            for (uint64_t i = 0; i < num; i++) impl[i] = std::move(from[i]);
+#ifdef ENABLE_WEIGHT
+            std::copy(from_weights, from_weights + num, weights());
+#endif
+            size = num;
+            if (size) max = impl[size - 1].get_dest();
+        }
+
+        // compacts the block, dropping the entries reclaimed by their version gc
+        uint64_t gc(uint64_t timestamp) {
+            auto impl = entries();
+            uint16_t cur = 0;
+            for (uint16_t i = 0; i < size; i++) {
+                if (impl[i].gc(timestamp)) continue;
+                if (cur != i) {
+                    impl[cur] = std::move(impl[i]);
+#ifdef ENABLE_WEIGHT
+                    weights()[cur] = weights()[i];
+#endif
+                }
+                cur++;
+            }
+            uint64_t reclaimed = size - cur;
+            for (uint16_t i = cur; i < size; i++) impl[i] = EdgeEntry();
+            size = cur;
+            if (size) max = impl[size - 1].get_dest();
+            return reclaimed;
+        }
+
+    private:
+        explicit EdgeBlock(uint64_t capacity) : max(0), size(0), capacity(capacity) {
+            for (int i = 0; i < SKIP_LIST_LEVELS; i++) next_levels[i] = nullptr;
+        }
+        ~EdgeBlock() = default;
     };
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <cstdint>
 #include <cstdlib>
 #include <random>
+#include <vector>
+#include <algorithm>
 
 namespace container {
     template<typename EdgeEntry>
@@ -19,14 +21,31 @@ namespace container {
         static thread_local std::mt19937 level_generator;
 
         EdgeBlock<EdgeEntry>* find_block(EdgeBlock<EdgeEntry>* cur_block, uint64_t dest, EdgeBlock<EdgeEntry> *blocks[SKIP_LIST_LEVELS]);
+        EdgeBlock<EdgeEntry>* find_block_from(uint64_t dest, EdgeBlock<EdgeEntry> *blocks[SKIP_LIST_LEVELS]);
+        void remove_block(EdgeBlock<EdgeEntry>* block);
+        void split_merge(EdgeBlock<EdgeEntry>* block, EdgeBlock<EdgeEntry> *blocks[SKIP_LIST_LEVELS], const std::vector<uint64_t> &fresh,
+                         const std::vector<double> &fresh_weights, uint64_t timestamp);
         uint64_t get_height();
 
     public:
         explicit SkipList(uint64_t block_size);
         ~SkipList();
-        bool insert_edge(uint64_t dest, uint64_t timestamp);
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0);
+        uint64_t insert_edge_batch(const uint64_t* dests, const double* weights, size_t num, uint64_t timestamp);
+        bool remove_edge(uint64_t dest, uint64_t timestamp);
         bool has_edge(uint64_t dest, uint64_t timestamp);
+        double get_weight(uint64_t dest, uint64_t timestamp);
+        uint64_t gc(uint64_t timestamp);
         SkipListIterator<EdgeEntry> begin(uint64_t);
+
+        // visits every stored entry in order with its weight, whatever its versions
+        template<typename F>
+        void for_each_entry(F&& callback) {
+            for (auto block = head; block != nullptr; block = block->next_levels[0]) {
+                auto entries = block->entries();
+                for (uint64_t i = 0; i < block->size; i++) callback(entries[i], block->weight_at(i));
+            }
+        }
     };
 
 
@@ -40,7 +59,7 @@ namespace container {
         if ((block_size & (block_size - 1)) != 0) {
             throw std::runtime_error("Block size must be a power of 2");
         }
-        head = new EdgeBlock<EdgeEntry>(block_size);
+        head = EdgeBlock<EdgeEntry>::create(block_size);
     }
 
     template<typename EdgeEntry>
@@ -48,7 +67,7 @@ namespace container {
         auto cur = head;
         while (cur != nullptr) {
             auto next = cur->next_levels[0];
-            delete cur;
+            EdgeBlock<EdgeEntry>::destroy(cur);
             cur = next;
         }
         head = nullptr;
@@ -69,6 +88,22 @@ namespace container {
     }
 
 
+    // resumes the search path left in blocks by a smaller dest instead of descending from the head again
+    template<typename EdgeEntry>
+    EdgeBlock<EdgeEntry>* SkipList<EdgeEntry>::find_block_from(uint64_t dest, EdgeBlock<EdgeEntry> *blocks[SKIP_LIST_LEVELS]) {
+        auto cur_block = blocks[SKIP_LIST_LEVELS - 1];
+        for (int l = SKIP_LIST_LEVELS - 1; l >= 0; l--) {
+            if (blocks[l]->max > cur_block->max) cur_block = blocks[l];
+            while (cur_block->next_levels[l] != nullptr && cur_block->next_levels[l]->max < dest
+                    && cur_block->next_levels[l]->next_levels[0] != nullptr) {
+                cur_block = cur_block->next_levels[l];
+            }
+            blocks[l] = cur_block;
+        }
+
+        return blocks[0]->next_levels[0] != nullptr && blocks[0]->max < dest ? blocks[0]->next_levels[0] : blocks[0];
+    }
+
     template<typename EdgeEntry>
     uint64_t SkipList<EdgeEntry>::get_height() {
         std::uniform_real_distribution<double> d(0.0, 1.0);
@@ -80,19 +115,15 @@ namespace container {
     }
 
     template<typename EdgeEntry>
-    bool SkipList<EdgeEntry>::insert_edge(uint64_t dest, uint64_t timestamp) {
+    bool SkipList<EdgeEntry>::insert_edge(uint64_t dest, uint64_t timestamp, double weight) {
         EdgeBlock<EdgeEntry>* blocks_per_level[SKIP_LIST_LEVELS]; 
         auto block = find_block(head, dest, blocks_per_level);
     
         if (block->size == block_size) {
-            EdgeBlock<EdgeEntry>* new_block = new EdgeBlock<EdgeEntry>(block_size);
+            EdgeBlock<EdgeEntry>* new_block = EdgeBlock<EdgeEntry>::create(block_size);
             block->split(*new_block);
 
             new_block->next_levels[0] = block->next_levels[0];
-            new_block->before = block;
-            if (new_block->next_levels[0] != nullptr) {
-                new_block->next_levels[0]->before = new_block;
-            }
             block->next_levels[0] = new_block;
 
             auto height = get_height();
@@ -109,12 +140,146 @@ namespace container {
                     new_block->next_levels[l] = nullptr;
                 }
             }
-            return insert_edge(dest, timestamp);
+            return insert_edge(dest, timestamp, weight);
         } else {
-            return block->insert_edge(dest, timestamp);
+            return block->insert_edge(dest, timestamp, weight);
+        }
+    }
+
+
+    // dests must be sorted; the search path only moves forward, every run of dests that falls into one block
+    // is merged at once and a block overflowing from a run is split into as many blocks as needed
+    template<typename EdgeEntry>
+    uint64_t SkipList<EdgeEntry>::insert_edge_batch(const uint64_t* dests, const double* weights, size_t num, uint64_t timestamp) {
+        static thread_local std::vector<uint64_t> fresh;
+        static thread_local std::vector<double> fresh_weights;
+        EdgeBlock<EdgeEntry>* blocks_per_level[SKIP_LIST_LEVELS];
+        uint64_t sum = 0;
+
+        size_t i = 0;
+        while (i < num) {
+            auto block = i == 0 ? find_block(head, dests[i], blocks_per_level) : find_block_from(dests[i], blocks_per_level);
+            size_t j = i + 1;
+            if (block->next_levels[0] == nullptr) j = num;
+            else while (j < num && dests[j] <= block->max) j++;
+
+            fresh.clear();
+            fresh_weights.clear();
+            sum += block->update_existing(dests + i, weights ? weights + i : nullptr, j - i, timestamp, fresh, fresh_weights);
+            sum += fresh.size();
+            if (block->size + fresh.size() <= block_size) block->merge_fresh(fresh, fresh_weights, timestamp);
+            else split_merge(block, blocks_per_level, fresh, fresh_weights, timestamp);
+            i = j;
+        }
+        return sum;
+    }
+
+    // spreads block merged with fresh over block and new blocks linked after it, each filled to about 3/4
+    template<typename EdgeEntry>
+    void SkipList<EdgeEntry>::split_merge(EdgeBlock<EdgeEntry>* block, EdgeBlock<EdgeEntry> *blocks[SKIP_LIST_LEVELS],
+                                          const std::vector<uint64_t> &fresh, const std::vector<double> &fresh_weights, uint64_t timestamp) {
+        static thread_local std::vector<EdgeEntry> merged;
+        static thread_local std::vector<double> merged_weights;
+        merged.clear();
+        merged_weights.clear();
+        block->drain_merged(fresh, fresh_weights, timestamp, merged, merged_weights);
+
+        uint64_t total = merged.size();
+        uint64_t fill = std::max<uint64_t>(block_size - block_size / 4, 1);
+        uint64_t num_blocks = (total + fill - 1) / fill;
+
+        EdgeBlock<EdgeEntry>* preds[SKIP_LIST_LEVELS];
+        for (uint l = 0; l < SKIP_LIST_LEVELS; l++) {
+            preds[l] = blocks[l]->next_levels[l] == block ? block : blocks[l];
+        }
+
+        uint64_t offset = 0;
+        auto prev = block;
+        for (uint64_t b = 0; b < num_blocks; b++) {
+            uint64_t count = total / num_blocks + (b < total % num_blocks);
+            if (b == 0) {
+                block->assign(merged.data(), merged_weights.data(), count);
+                offset += count;
+                continue;
+            }
+            auto new_block = EdgeBlock<EdgeEntry>::create(block_size);
+            new_block->assign(merged.data() + offset, merged_weights.data() + offset, count);
+            offset += count;
+
+            new_block->next_levels[0] = prev->next_levels[0];
+            prev->next_levels[0] = new_block;
+            prev = new_block;
+
+            auto height = get_height();
+            for (uint l = 1; l < height; l++) {
+                new_block->next_levels[l] = preds[l]->next_levels[l];
+                preds[l]->next_levels[l] = new_block;
+                preds[l] = new_block;
+            }
+        }
+        merged.clear();
+    }
+
+    template<typename EdgeEntry>
+    bool SkipList<EdgeEntry>::remove_edge(uint64_t dest, uint64_t timestamp) {
+        EdgeBlock<EdgeEntry>* blocks_per_level[SKIP_LIST_LEVELS];
+        auto block = find_block(head, dest, blocks_per_level);
+
+        if (!block->remove_edge(dest, timestamp)) return false;
+        if (block->size == 0) remove_block(block);
+        return true;
+    }
+
+    // unlinks an empty block; the head is kept as the entry point by pulling in its successor
+    template<typename EdgeEntry>
+    void SkipList<EdgeEntry>::remove_block(EdgeBlock<EdgeEntry>* block) {
+        if (block == head) {
+            auto next = head->next_levels[0];
+            if (next == nullptr) return;
+            auto head_impl = head->entries();
+            auto next_impl = next->entries();
+            for (uint64_t i = 0; i < next->size; i++) {
+                head_impl[i] = std::move(next_impl[i]);
+            }
+#ifdef ENABLE_WEIGHT
+            std::copy(next->weights(), next->weights() + next->size, head->weights());
+#endif
+            head->size = next->size;
+            head->max = next->max;
+            block = next;
         }
+
+        // block->max still holds the largest key it had, so the predecessors on each level are found by key
+        auto key = block->max;
+        auto cur_block = head;
+        for (int l = SKIP_LIST_LEVELS - 1; l >= 0; l--) {
+            while (cur_block->next_levels[l] != nullptr && cur_block->next_levels[l] != block
+                    && cur_block->next_levels[l]->max < key) {
+                cur_block = cur_block->next_levels[l];
+            }
+            if (cur_block->next_levels[l] == block) cur_block->next_levels[l] = block->next_levels[l];
+        }
+        EdgeBlock<EdgeEntry>::destroy(block);
     }
 
+    template<typename EdgeEntry>
+    uint64_t SkipList<EdgeEntry>::gc(uint64_t timestamp) {
+        uint64_t reclaimed = 0;
+        auto block = head;
+        while (block != nullptr) {
+            reclaimed += block->gc(timestamp);
+            if (block->size != 0 || (block == head && block->next_levels[0] == nullptr)) {
+                block = block->next_levels[0];
+            } else if (block == head) {
+                remove_block(head);     // head now holds its successor's entries, collect them as well
+            } else {
+                auto next = block->next_levels[0];
+                remove_block(block);
+                block = next;
+            }
+        }
+        return reclaimed;
+    }
 
     template<typename EdgeEntry>
     bool SkipList<EdgeEntry>::has_edge(uint64_t dest, uint64_t timestamp) {
@@ -122,8 +287,8 @@ namespace container {
             EdgeBlock<EdgeEntry> *blocks[SKIP_LIST_LEVELS];
             auto block = find_block(head, dest, blocks);
 
-            auto begin = block->impl.begin();
-            auto end = block->impl.begin() + block->size;
+            auto begin = block->entries();
+            auto end = begin + block->size;
             EdgeEntry value(dest);
             auto pos = std::lower_bound(begin, end, value);
             if (pos != end && pos->get_dest() == dest && pos->check_version(timestamp)) return true;
@@ -132,6 +297,19 @@ namespace container {
         return false;
     }
 
+    template<typename EdgeEntry>
+    double SkipList<EdgeEntry>::get_weight(uint64_t dest, uint64_t timestamp) {
+        EdgeBlock<EdgeEntry> *blocks[SKIP_LIST_LEVELS];
+        auto block = find_block(head, dest, blocks);
+
+        auto begin = block->entries();
+        auto end = begin + block->size;
+        EdgeEntry value(dest);
+        auto pos = std::lower_bound(begin, end, value);
+        if (pos != end && pos->get_dest() == dest && pos->check_version(timestamp)) return block->weight_at(pos - begin);
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
     template<typename EdgeEntry>
     SkipListIterator<EdgeEntry> SkipList<EdgeEntry>::begin(uint64_t timestamp) {
         SkipListIterator<EdgeEntry> it(head, timestamp);
@@ -169,7 +347,7 @@ namespace container {
                     } else {
                         index++;
                     }
-                } while (__builtin_expect(valid() && !block->impl[index].check_version(timestamp), 1));
+                } while (__builtin_expect(valid() && !block->entries()[index].check_version(timestamp), 1));
             }
             return *this;
         }
@@ -189,11 +367,15 @@ namespace container {
         }
 
         EdgeEntry& operator*() {
-            return block->impl[index];
+            return block->entries()[index];
         }
 
         EdgeEntry* operator->() {
-            return &(block->impl[index]);
+            return &(block->entries()[index]);
+        }
+
+        double weight() const {
+            return block->weight_at(index);
         }
 
         bool valid() {
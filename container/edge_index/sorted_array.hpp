@@ -6,9 +6,12 @@
 #include <limits>
 #include <memory>
 #include <stdexcept>
+#include <tbb/parallel_for.h>
 
 #include "utils/types.hpp"
 #include "utils/config.hpp"
+#include "utils/intersect.hpp"
+#include "utils/batch.hpp"
 #include "../types/types.hpp"
 
 namespace container {
@@ -17,10 +20,22 @@ namespace container {
 
     template<typename EdgeEntry>
     struct SortedArrayEdgeIndex {
+        // batches with at least this many new edges for one vertex are merged in parallel
+        static constexpr uint64_t PARALLEL_MERGE_THRESHOLD = 1 << 16;
+        static constexpr uint64_t PARALLEL_MERGE_GRAIN = 1 << 14;
+        static constexpr bool FAST_PROBE = true;
+
         std::vector<EdgeEntry>* m_arr;
+#ifdef ENABLE_WEIGHT
+        // weights in the order of m_arr, kept apart so scans which ignore them never load them
+        std::vector<double>* m_weights;
+#endif
 
         SortedArrayEdgeIndex() {
             m_arr = new std::vector<EdgeEntry>();
+#ifdef ENABLE_WEIGHT
+            m_weights = new std::vector<double>();
+#endif
         }
         
         ~SortedArrayEdgeIndex() = default;
@@ -34,88 +49,197 @@ namespace container {
             return false;
         }
 
+        // NaN if the edge is not visible at timestamp
+        double get_weight(uint64_t dest, uint64_t timestamp) const {
+            EdgeEntry value(dest);
+            auto it = std::lower_bound(m_arr->begin(), m_arr->end(), value);
+            if (it == m_arr->end() || it->get_dest() != dest || !it->check_version(timestamp)) return std::numeric_limits<double>::quiet_NaN();
+#ifdef ENABLE_WEIGHT
+            return (*m_weights)[it - m_arr->begin()];
+#else
+            return 0.0;
+#endif
+        }
+
         uint64_t intersect(const SortedArrayEdgeIndex<EdgeEntry> & other, uint64_t timestamp) const {
-            uint64_t sum = 0;
-            auto neighbor_a = m_arr;
-            auto iter_a = neighbor_a->begin();
-            auto neighbor_b = other.m_arr;
-            auto iter_b = neighbor_b->begin();
-
-            // TODO: add optimization
-            while (iter_a != neighbor_a->end() && iter_b != neighbor_b->end()) {
-                if (iter_a->get_dest() < iter_b->get_dest()) {
-                    ++iter_a;
-                } else if (iter_a->get_dest() > iter_b->get_dest()) {
-                    ++iter_b;
-                } else {
-                    sum++;
-                    ++iter_a;
-                    ++iter_b;
-                }
-            }
-            return sum;
+            return intersect::neighbors(*this, other, timestamp);
         }
 
 
-        bool insert_edge(uint64_t dest, uint64_t timestamp) {
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0) {
             EdgeEntry entry(dest);
             auto iter = std::lower_bound(m_arr->begin(), m_arr->end(), entry);
             auto value = EdgeEntry{dest, timestamp};
+#ifdef ENABLE_WEIGHT
+            auto weight_iter = m_weights->begin() + (iter - m_arr->begin());
+#endif
 
             if (iter != m_arr->end() && iter->get_dest() == dest) {
+                bool revived = iter->is_deleted();
                 iter->update_version(timestamp);
-                return false;
+#ifdef ENABLE_WEIGHT
+                *weight_iter = weight;
+#endif
+                return revived;
             } else {
                 m_arr->insert(iter, std::move(value));
+#ifdef ENABLE_WEIGHT
+                m_weights->insert(weight_iter, weight);
+#endif
             }
             return true;
         }
 
-        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp) {
-            // uint64_t sum = 0;
-            // std::vector<EdgeEntry> result;
-            // result.reserve(m_arr->size() + dest_list.size());
-
-            // auto old_iter = m_arr->begin();
-            // auto new_iter = dest_list.begin();
-            
-            // while (old_iter != m_arr->end() && new_iter != dest_list.end()) {
-            //     if (old_iter->get_dest() < *new_iter) {
-            //         result.push_back(std::move(*old_iter));
-            //         old_iter++;
-            //     } else if (old_iter->get_dest() > *new_iter) {
-            //         result.emplace_back(*new_iter, timestamp);
-            //         new_iter++;
-            //         sum++;
-            //     } else {
-            //         old_iter->update_version(timestamp);
-            //         result.push_back(std::move(*old_iter));
-            //         new_iter++;
-            //         old_iter++;
-            //     }
-            // }
-
-            // while (old_iter != m_arr->end()) {
-            //     result.push_back(std::move(*old_iter));
-            //     old_iter++;
-            // }
-
-            // while (new_iter != dest_list.end()) {
-            //     result.emplace_back(*new_iter, timestamp);
-            //     new_iter++;
-            //     sum++;
-            // }
-
-            // m_arr->swap(result);
-
-            // return sum;
+        bool remove_edge(uint64_t dest, uint64_t timestamp) {
+            EdgeEntry entry(dest);
+            auto iter = std::lower_bound(m_arr->begin(), m_arr->end(), entry);
+            if (iter == m_arr->end() || iter->get_dest() != dest || iter->is_deleted()) return false;
+#ifdef ENABLE_TIMESTAMP
+            iter->delete_version(timestamp);
+#else
+#ifdef ENABLE_WEIGHT
+            m_weights->erase(m_weights->begin() + (iter - m_arr->begin()));
+#endif
+            m_arr->erase(iter);
+#endif
+            return true;
+        }
+
+        uint64_t gc(uint64_t timestamp) {
+            auto &arr = *m_arr;
+            uint64_t cur = 0;
+            for (uint64_t i = 0; i < arr.size(); i++) {
+                if (arr[i].gc(timestamp)) continue;
+                if (cur != i) {
+                    arr[cur] = std::move(arr[i]);
+#ifdef ENABLE_WEIGHT
+                    (*m_weights)[cur] = (*m_weights)[i];
+#endif
+                }
+                cur++;
+            }
+            uint64_t reclaimed = arr.size() - cur;
+            arr.resize(cur);
+#ifdef ENABLE_WEIGHT
+            m_weights->resize(cur);
+#endif
+            return reclaimed;
+        }
+
+        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {}) {
+            if (std::is_sorted(dest_list.begin(), dest_list.end())) return insert_sorted_batch(dest_list, timestamp, weight_list.empty() ? nullptr : weight_list.data());
+            std::vector<uint64_t> sorted_list(dest_list);
+            std::vector<double> sorted_weights(weight_list);
+            batch::sort(sorted_list, sorted_weights);
+            return insert_sorted_batch(sorted_list, timestamp, sorted_weights.empty() ? nullptr : sorted_weights.data());
+        }
+
+        // existing entries are updated in place, the new ones are merged in with a single pass
+        uint64_t insert_sorted_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const double* weights = nullptr) {
+            static thread_local std::vector<uint64_t> fresh;
+            static thread_local std::vector<double> fresh_weights;
+            fresh.clear();
+            fresh_weights.clear();
             uint64_t sum = 0;
-            for (auto & dest : dest_list) {
-                sum += insert_edge(dest, timestamp);
+
+            auto pos = m_arr->begin();
+            for (uint64_t i = 0; i < dest_list.size(); i++) {
+                auto dest = dest_list[i];
+                if (i > 0 && dest == dest_list[i - 1]) continue;
+                pos = std::lower_bound(pos, m_arr->end(), dest, [] (const EdgeEntry &entry, uint64_t dest) {
+                    return entry.get_dest() < dest;
+                });
+                double weight = weights ? weights[i] : 0.0;
+                if (pos != m_arr->end() && pos->get_dest() == dest) {
+                    sum += pos->is_deleted();
+                    pos->update_version(timestamp);
+#ifdef ENABLE_WEIGHT
+                    (*m_weights)[pos - m_arr->begin()] = weight;
+#endif
+                } else {
+                    fresh.push_back(dest);
+                    fresh_weights.push_back(weight);
+                }
+            }
+            if (fresh.empty()) return sum;
+            sum += fresh.size();
+
+            if (fresh.size() >= PARALLEL_MERGE_THRESHOLD) {
+                parallel_merge(fresh, fresh_weights, timestamp);
+                return sum;
+            }
+
+            // merge from the back, so every old entry is moved at most once
+            int64_t read = m_arr->size() - 1;
+            m_arr->resize(m_arr->size() + fresh.size());
+            int64_t write = m_arr->size() - 1;
+            auto &arr = *m_arr;
+#ifdef ENABLE_WEIGHT
+            m_weights->resize(m_arr->size());
+            auto &arr_weights = *m_weights;
+#endif
+            for (int64_t i = fresh.size() - 1; i >= 0; write--) {
+                if (read >= 0 && arr[read].get_dest() > fresh[i]) {
+#ifdef ENABLE_WEIGHT
+                    arr_weights[write] = arr_weights[read];
+#endif
+                    arr[write] = std::move(arr[read--]);
+                } else {
+#ifdef ENABLE_WEIGHT
+                    arr_weights[write] = fresh_weights[i];
+#endif
+                    arr[write] = EdgeEntry(fresh[i--], timestamp);
+                }
             }
             return sum;
         }
 
+        // every task merges a slice of fresh with the old entries falling between its bounds,
+        // the output offset of a slice is known from the two bounds alone
+        void parallel_merge(const std::vector<uint64_t> &fresh, const std::vector<double> &fresh_weights, uint64_t timestamp) {
+            std::vector<EdgeEntry> result(m_arr->size() + fresh.size());
+#ifdef ENABLE_WEIGHT
+            std::vector<double> result_weights(result.size());
+#endif
+            auto old_begin = m_arr->begin();
+            auto old_end = m_arr->end();
+            auto cmp = [] (const EdgeEntry &entry, uint64_t dest) {
+                return entry.get_dest() < dest;
+            };
+
+            uint64_t num_tasks = (fresh.size() + PARALLEL_MERGE_GRAIN - 1) / PARALLEL_MERGE_GRAIN;
+            tbb::parallel_for(uint64_t(0), num_tasks, [&] (uint64_t task) {
+                uint64_t lo = task * PARALLEL_MERGE_GRAIN;
+                uint64_t hi = std::min<uint64_t>(lo + PARALLEL_MERGE_GRAIN, fresh.size());
+                auto old_iter = task == 0 ? old_begin : std::lower_bound(old_begin, old_end, fresh[lo], cmp);
+                auto old_last = hi == fresh.size() ? old_end : std::lower_bound(old_begin, old_end, fresh[hi], cmp);
+                auto out = result.begin() + lo + (old_iter - old_begin);
+
+                for (uint64_t i = lo; i < hi; i++) {
+                    while (old_iter != old_last && old_iter->get_dest() < fresh[i]) {
+#ifdef ENABLE_WEIGHT
+                        result_weights[out - result.begin()] = (*m_weights)[old_iter - old_begin];
+#endif
+                        *out++ = std::move(*old_iter++);
+                    }
+#ifdef ENABLE_WEIGHT
+                    result_weights[out - result.begin()] = fresh_weights[i];
+#endif
+                    *out++ = EdgeEntry(fresh[i], timestamp);
+                }
+                while (old_iter != old_last) {
+#ifdef ENABLE_WEIGHT
+                    result_weights[out - result.begin()] = (*m_weights)[old_iter - old_begin];
+#endif
+                    *out++ = std::move(*old_iter++);
+                }
+            });
+            m_arr->swap(result);
+#ifdef ENABLE_WEIGHT
+            m_weights->swap(result_weights);
+#endif
+        }
+
         template<typename F>
         uint64_t edges(F&& callback, uint64_t timestamp) const {
             uint64_t sum = 0;
@@ -123,7 +247,11 @@ namespace container {
             for (uint64_t i = 0; i < size; i++) {
                 auto & entry = (*m_arr)[i];
                 if (__builtin_expect(entry.check_version(timestamp), 1)) {
-                    bool should_continue = callback(entry.get_dest(), 0.0); // NOTE: Do not support weight now
+#ifdef ENABLE_WEIGHT
+                    bool should_continue = callback(entry.get_dest(), (*m_weights)[i]);
+#else
+                    bool should_continue = callback(entry.get_dest(), 0.0);
+#endif
                     sum += entry.get_dest();
                     if (!should_continue) break;
                 }
@@ -131,6 +259,18 @@ namespace container {
             return sum;
         }
 
+        // visits every stored entry in order with its weight, whatever its versions
+        template<typename F>
+        void for_each_entry(F&& callback) {
+            for (uint64_t i = 0; i < m_arr->size(); i++) {
+#ifdef ENABLE_WEIGHT
+                callback((*m_arr)[i], (*m_weights)[i]);
+#else
+                callback((*m_arr)[i], 0.0);
+#endif
+            }
+        }
+
         void init_graph(std::vector<uint64_t> &dest, uint64_t start, uint64_t end, EdgeDriverConfig exp_cfg = EdgeDriverConfig(), std::vector<uint64_t> timestamp_arr = std::vector<uint64_t>{}) {
             std::sort(dest.begin() + start, dest.begin() + end);
             std::vector<uint64_t> unique;
@@ -144,15 +284,24 @@ namespace container {
                 auto entry = EdgeEntry{unique[i], i + start};
                 m_arr->push_back(std::move(entry)); 
             }
+#ifdef ENABLE_WEIGHT
+            m_weights->resize(m_arr->size());
+#endif
         }
 
         void clear() {
             if (m_arr) delete m_arr;
             m_arr = nullptr;
+#ifdef ENABLE_WEIGHT
+            if (m_weights) delete m_weights;
+            m_weights = nullptr;
+#endif
         }
 
         SortedArrayIterator<EdgeEntry> get_begin(uint64_t timestamp) const {
-            return SortedArrayIterator<EdgeEntry>(m_arr->begin(), m_arr, timestamp);
+            SortedArrayIterator<EdgeEntry> it(m_arr->begin(), m_arr, timestamp);
+            if (it.valid() && !it->check_version(timestamp)) ++it;
+            return it;
         }
     };
 
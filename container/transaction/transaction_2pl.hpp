@@ -8,11 +8,17 @@
 #include <cstdint>
 #include <algorithm>
 #include <atomic>
+#include <limits>
 #include <iostream>
 #include <mutex>
 #include <tbb/parallel_sort.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 #include "utils/config.hpp"
 #include "utils/types.hpp"
+#include "utils/lock_table.hpp"
+#include "utils/thread_slots.hpp"
+#include "utils/worker_pool.hpp"
 #include "types/types.hpp"
 
 using PUU = std::pair<uint64_t, uint64_t>;
@@ -24,22 +30,66 @@ namespace container {
     template<typename Container>
     struct WriteTransaction;
 
+    /// Tracks the oldest snapshot still read, so gc knows which versions it may drop
+    ///
+    /// Every thread publishes the oldest timestamp it reads in its own padded slot; beginning and
+    /// ending a read transaction only touch that slot, the gc thread scans all of them. A thread
+    /// stores a lower bound before it reads the global timestamp for its snapshot, and gc reads the
+    /// global timestamp before it scans, so it either sees the slot or a timestamp the snapshot is
+    /// not older than. The slots are shared by all managers, which only ever makes gc keep more.
+    /// Read transactions have to end on the thread they began on.
     struct ActiveVersionManager {
     private:
+        static constexpr uint32_t MAX_READERS = 1024;
+        static constexpr uint64_t NONE = std::numeric_limits<uint64_t>::max();
+
+        struct ReaderEpoch {
+            std::atomic<uint64_t> timestamp {NONE};     // oldest snapshot the thread reads
+            uint32_t active = 0;                        // read transactions the thread has open
+        };
+        using Epochs = ThreadSlots<ReaderEpoch, MAX_READERS>;
+
         std::atomic<uint64_t> min_timestamp {0};
-        std::unordered_multiset<uint64_t> active_read_transactions;
+        // steady clock ticks before which writers make do with min_timestamp
+        std::atomic<int64_t> next_refresh {0};
+
+        // threads that found every slot taken, counted before they read the global timestamp
+        std::unordered_multiset<uint64_t> overflow;
+        std::atomic<uint64_t> overflow_num {0};
         std::mutex mtx;
     public:
-        void begin_read_transaction(uint64_t timestamp) {
-            std::lock_guard<std::mutex> lock(mtx);
-            active_read_transactions.insert(timestamp);
-        } 
+        // returns the timestamp of the new snapshot
+        uint64_t begin_read_transaction(const std::atomic<uint64_t> &global_timestamp) {
+            auto epoch = Epochs::mine();
+            if (__builtin_expect(epoch == nullptr, 0)) {
+                std::lock_guard<std::mutex> lock(mtx);
+                overflow_num.fetch_add(1, std::memory_order_seq_cst);
+                uint64_t timestamp = global_timestamp.load(std::memory_order_seq_cst);
+                overflow.insert(timestamp);
+                return timestamp;
+            }
+            uint64_t bound = global_timestamp.load(std::memory_order_seq_cst);
+            if (bound < epoch->timestamp.load(std::memory_order_relaxed)) {
+                epoch->timestamp.store(bound, std::memory_order_seq_cst);
+            }
+            epoch->active++;
+            return global_timestamp.load(std::memory_order_seq_cst);
+        }
 
         void end_read_transaction(uint64_t timestamp) {
-            std::lock_guard<std::mutex> lock(mtx);
-            auto it = active_read_transactions.find(timestamp);
-            if (it != active_read_transactions.end()) {
-                active_read_transactions.erase(it);
+            auto epoch = Epochs::mine();
+            if (__builtin_expect(epoch == nullptr, 0)) {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = overflow.find(timestamp);
+                if (it != overflow.end()) {
+                    overflow.erase(it);
+                    overflow_num.fetch_sub(1, std::memory_order_release);
+                }
+                return;
+            }
+            // the slot keeps the oldest bound until the thread has no snapshot open anymore
+            if (epoch->active > 0 && --epoch->active == 0) {
+                epoch->timestamp.store(NONE, std::memory_order_release);
             }
         }
 
@@ -47,32 +97,156 @@ namespace container {
             return min_timestamp.load(std::memory_order_acquire);
         }
 
+        /// The last bound gc or a writer computed. Writers call this, so one that needs a newer bound
+        /// rescans only if nobody did within config::SNAPSHOT_REFRESH_US; the others get the older
+        /// bound, which only makes them keep more.
+        uint64_t snapshot_bound(uint64_t needed, const std::atomic<uint64_t> &global_timestamp) {
+            uint64_t bound = get_min_timestamp();
+            if (bound >= needed) return bound;
+            int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+            int64_t next = next_refresh.load(std::memory_order_relaxed);
+            if (now < next) return bound;
+            auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::microseconds(config::SNAPSHOT_REFRESH_US));
+            if (!next_refresh.compare_exchange_strong(next, now + period.count(), std::memory_order_relaxed)) return bound;
+            update_min_version(global_timestamp.load(std::memory_order_seq_cst));
+            return get_min_timestamp();
+        }
+
+        // global_timestamp has to be read before this is called; a concurrent call may store an older
+        // bound over a newer one, which is still a bound and only keeps more
         void update_min_version(uint64_t global_timestamp) {
-            std::lock_guard<std::mutex> lock(mtx);
-            if (active_read_transactions.empty()) {
-                min_timestamp.store(global_timestamp, std::memory_order_release); 
-            } else {
-                auto min_ts = *std::min_element(active_read_transactions.begin(), active_read_transactions.end());
-                min_timestamp.store(min_ts, std::memory_order_release);
+            uint64_t min_ts = global_timestamp;
+            Epochs::for_each([&min_ts] (ReaderEpoch &epoch) {
+                min_ts = std::min(min_ts, epoch.timestamp.load(std::memory_order_seq_cst));
+            });
+            // an overflowing reader not counted yet reads the global timestamp after we did
+            if (overflow_num.load(std::memory_order_seq_cst) != 0) {
+                std::lock_guard<std::mutex> lock(mtx);
+                for (auto timestamp : overflow) min_ts = std::min(min_ts, timestamp);
             }
-            // std::cout << min_timestamp << ' ' << global_timestamp << std::endl;
+            min_timestamp.store(min_ts, std::memory_order_release);
         }
     };
 
+#ifdef ENABLE_GROUP_COMMIT
+    /// Lets concurrent writers share one timestamp instead of drawing one each (ENABLE_GROUP_COMMIT)
+    ///
+    /// The global timestamp holds the last closed group, writers join the one after it by
+    /// announcing it in their own slot and apply their updates with its timestamp. The first member
+    /// done closes the group with a single CAS, waits for the other members to leave and makes the
+    /// group visible; readers snapshot the visible timestamp, so they see whole groups or nothing.
+    struct CommitGroups {
+    private:
+        static constexpr uint32_t MAX_WRITERS = 1024;
+        static constexpr uint64_t NONE = std::numeric_limits<uint64_t>::max();
+
+        struct WriterEpoch {
+            std::atomic<uint64_t> group {NONE};         // group the thread applies updates for
+        };
+        using Epochs = ThreadSlots<WriterEpoch, MAX_WRITERS>;
+
+        std::atomic<uint64_t> visible {0};
+
+        // threads that found every slot taken
+        std::unordered_multiset<uint64_t> overflow;
+        std::mutex mtx;
+    public:
+        // leaves the group once the updates are applied, also if applying them throws
+        struct Member {
+            CommitGroups &groups;
+            uint64_t group;
+            ~Member() { groups.leave(group); }
+        };
+
+        // returns the timestamp of the open group, the writer stays a member until it leaves
+        uint64_t join(const std::atomic<uint64_t> &closed) {
+            auto epoch = Epochs::mine();
+            if (__builtin_expect(epoch == nullptr, 0)) {
+                std::lock_guard<std::mutex> lock(mtx);
+                uint64_t group = closed.load() + 1;
+                overflow.insert(group);
+                return group;
+            }
+            while (true) {
+                uint64_t group = closed.load(std::memory_order_seq_cst) + 1;
+                epoch->group.store(group, std::memory_order_seq_cst);
+                if (closed.load(std::memory_order_seq_cst) + 1 == group) return group;
+            }
+        }
+
+        void leave(uint64_t group) {
+            auto epoch = Epochs::mine();
+            if (__builtin_expect(epoch == nullptr, 0)) {
+                std::lock_guard<std::mutex> lock(mtx);
+                overflow.erase(overflow.find(group));
+                return;
+            }
+            epoch->group.store(NONE, std::memory_order_release);
+        }
+
+        // returns once the group is visible; call it after leaving, with no vertex locks held
+        void publish(std::atomic<uint64_t> &closed, uint64_t group) {
+            for (unsigned k = 0; visible.load(std::memory_order_acquire) < group; k++) {
+                uint64_t previous = group - 1;
+                if (closed.load(std::memory_order_relaxed) == previous && closed.compare_exchange_strong(previous, group)) {
+                    close(group);
+                    return;
+                }
+                RWSpinLock::yield(k);
+            }
+        }
+
+        const std::atomic<uint64_t>& visible_timestamp() const {
+            return visible;
+        }
+
+    private:
+        // nobody joins the group anymore, wait for the members still applying updates
+        void close(uint64_t group) {
+            Epochs::for_each([group] (WriterEpoch &epoch) {
+                for (unsigned k = 0; epoch.group.load(std::memory_order_seq_cst) == group; k++) {
+                    RWSpinLock::yield(k);
+                }
+            });
+            for (unsigned k = 0; ; k++) {
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (overflow.count(group) == 0) break;
+                }
+                RWSpinLock::yield(k);
+            }
+            // groups become visible in the order they were closed
+            for (unsigned k = 0; visible.load(std::memory_order_acquire) != group - 1; k++) {
+                RWSpinLock::yield(k);
+            }
+            visible.store(group, std::memory_order_release);
+        }
+    };
+#endif
+
     template<typename Container>
     struct TransactionManager {
         std::atomic<uint64_t> global_timestamp {0};
         mutable ActiveVersionManager version_manager;
+#ifdef ENABLE_GROUP_COMMIT
+        CommitGroups commit_groups;
+#endif
 
         std::atomic<bool> stopped {true};
         std::thread gc_all;
         Container* container_impl;
+#ifdef ENABLE_GC
+        // helps the gc thread, which makes the GC_WORKERS-th worker
+        WorkerPool gc_workers {std::max<uint32_t>(config::GC_WORKERS, 1) - 1};
+#endif
 
-        explicit TransactionManager(bool is_directed, bool is_weighted)
-            : gc_all(&TransactionManager::garbage_collector, this, 5000)
-        {
-            container_impl = new Container(is_directed, is_weighted);
+        // gc_interval in milliseconds, see config::GC_INTERVAL_MS
+        explicit TransactionManager(bool is_directed, bool is_weighted, uint64_t gc_interval = config::GC_INTERVAL_MS) {
+            container_impl = new Container(is_directed, is_weighted, [this] (uint64_t needed) {
+                return version_manager.snapshot_bound(needed, read_timestamp());
+            });
             stopped.store(false);
+            gc_all = std::thread(&TransactionManager::garbage_collector, this, gc_interval);
         }
 
         ~TransactionManager() {
@@ -90,17 +264,29 @@ namespace container {
         }
 
         auto get_read_transaction() const {
-            uint64_t timestamp = global_timestamp.load();
-            version_manager.begin_read_transaction(timestamp);
+            uint64_t timestamp = version_manager.begin_read_transaction(read_timestamp());
             return ReadTransaction<Container>(this->container_impl, this, timestamp);
         }
 
-        void garbage_collector(uint interval) {
+        // newest timestamp whose updates are all applied; with group commit the open group is not
+        const std::atomic<uint64_t>& read_timestamp() const {
+#ifdef ENABLE_GROUP_COMMIT
+            return commit_groups.visible_timestamp();
+#else
+            return global_timestamp;
+#endif
+        }
+
+        void garbage_collector(uint64_t interval) {
 #ifdef ENABLE_GC
             while (!stopped.load()) {
-                this->version_manager.update_min_version(global_timestamp.load());
-                this->container_impl->gc_all(version_manager.get_min_timestamp());
-                std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+                this->version_manager.update_min_version(read_timestamp().load());
+                this->container_impl->gc_all(version_manager.get_min_timestamp(), gc_workers);
+                // wakes up now and then, so stopping does not wait for a whole interval
+                auto wake = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval);
+                while (!stopped.load() && std::chrono::steady_clock::now() < wake) {
+                    std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(wake - std::chrono::steady_clock::now(), std::chrono::milliseconds(100)));
+                }
             }
 #endif
         }
@@ -120,39 +306,32 @@ namespace container {
             : container_impl(container_impl), tm(tm), timestamp(timestamp) {}
 
         bool has_vertex(uint64_t vertex) const {
-#ifdef ENABLE_LOCK
+#if defined(ENABLE_LOCK) && !defined(ENABLE_OPTIMISTIC_READ)
             container_impl->acquire_lock_shared({vertex, false});
 #endif
             auto res = container_impl->has_vertex(vertex);
-#ifdef ENABLE_LOCK
+#if defined(ENABLE_LOCK) && !defined(ENABLE_OPTIMISTIC_READ)
             container_impl->release_lock_shared({vertex, false});
 #endif
             return res;
         }
 
         bool has_edge(uint64_t source, uint64_t destination) const {
-#ifdef ENABLE_LOCK
-            container_impl->acquire_lock_shared({source, false});
-#endif
-            auto res = container_impl->has_edge(source, destination, timestamp);
-#ifdef ENABLE_LOCK
-            container_impl->release_lock_shared({source, false});
-#endif
+            bool res;
+            read_vertex(source, [&] { res = container_impl->has_edge(source, destination, timestamp); });
             return res;
         }
 
-
+        // NaN if the edge does not exist
+        double get_weight(uint64_t source, uint64_t destination) const {
+            double res;
+            read_vertex(source, [&] { res = container_impl->get_weight(source, destination, timestamp); });
+            return res;
+        }
 
         uint64_t intersect(uint64_t vtx_a, uint64_t vtx_b) const {
-#ifdef ENABLE_LOCK
-            container_impl->acquire_lock_shared({vtx_a, false});
-            container_impl->acquire_lock_shared({vtx_b, false});
-#endif
-            auto res = container_impl->intersect(vtx_a, vtx_b, timestamp);
-#ifdef ENABLE_LOCK
-            container_impl->acquire_lock_shared({vtx_a, false});
-            container_impl->acquire_lock_shared({vtx_b, false});
-#endif
+            uint64_t res;
+            read_vertices(vtx_a, vtx_b, [&] { res = container_impl->intersect(vtx_a, vtx_b, timestamp); });
             return res;
         }
 
@@ -165,49 +344,22 @@ namespace container {
         }
 
         uint64_t get_degree(uint64_t source) const {
-#ifdef ENABLE_LOCK
-            container_impl->acquire_lock_shared({source, false});
-#endif
-            auto res = container_impl->get_degree(source, timestamp);
-#ifdef ENABLE_LOCK
-            container_impl->release_lock_shared({source, false});
-#endif
+            uint64_t res;
+            read_vertex(source, [&] { res = container_impl->get_degree(source, timestamp); });
             return res;
         }
 
         void get_neighbor(uint64_t src, std::vector<uint64_t> &neighbor) const {
-#ifdef ENABLE_LOCK
-            container_impl->acquire_lock_shared({container::config::VERTEX_INDEX_LOCK_IDX, false});
-            container_impl->acquire_lock_shared({src, false});
-#endif
-            container_impl->get_neighbor(src, neighbor, timestamp);
-#ifdef ENABLE_LOCK
-            container_impl->release_lock_shared({container::config::VERTEX_INDEX_LOCK_IDX, false});
-            container_impl->release_lock_shared({src, false});
-#endif
+            read_vertex(src, [&] { container_impl->get_neighbor(src, neighbor, timestamp); }, true);
         }
 
         void get_neighbor_ptr(uint64_t vertex) const {
-#ifdef ENABLE_LOCK
-            container_impl->acquire_lock_shared({container::config::VERTEX_INDEX_LOCK_IDX, false});
-            container_impl->acquire_lock_shared({vertex, false});
-#endif
-            volatile void* addr = container_impl->get_neighbor_ptr(vertex);
-#ifdef ENABLE_LOCK
-            container_impl->release_lock_shared({container::config::VERTEX_INDEX_LOCK_IDX, false});
-            container_impl->release_lock_shared({vertex, false});
-#endif
+            read_vertex(vertex, [&] { volatile void* addr = container_impl->get_neighbor_ptr(vertex); }, true);
         }
 
         template<typename F>
         void edges(uint64_t src, F&& callback) const {
-#ifdef ENABLE_LOCK
-            container_impl->acquire_lock_shared({src, false});
-#endif
-            container_impl->edges(src, callback, timestamp);
-#ifdef ENABLE_LOCK
-            container_impl->release_lock_shared({src, false});
-#endif
+            read_vertex(src, [&] { container_impl->edges(src, callback, timestamp); });
         }
 
         void get_vertices(std::vector<uint64_t> &vertices) {
@@ -229,24 +381,176 @@ namespace container {
             tm->version_manager.end_read_transaction(timestamp);
             return true;
         }
+
+    private:
+        // runs read with vertex protected from writers; optimistic readers announce the vertex
+        // instead of locking it and fall back to the shared lock if writers keep holding it
+        template<typename F>
+        void read_vertex(uint64_t vertex, F&& read, bool index_lock = false) const {
+#ifdef ENABLE_OPTIMISTIC_READ
+            if (auto slot = optimistic::my_slot()) {
+                auto &version = container_impl->get_version(vertex);
+                for (unsigned k = 0; k < optimistic::MAX_RETRIES; k++) {
+                    if (slot->enter(0, version, lock_table::order_of(vertex))) {
+                        optimistic::Leave leave{slot, 0};
+                        read();
+                        return;
+                    }
+                    RWSpinLock::yield(k);
+                }
+            }
+#endif
+#ifdef ENABLE_LOCK
+            if (index_lock) container_impl->acquire_lock_shared({container::config::VERTEX_INDEX_LOCK_IDX, false});
+            container_impl->acquire_lock_shared({vertex, false});
+#endif
+            read();
+#ifdef ENABLE_LOCK
+            if (index_lock) container_impl->release_lock_shared({container::config::VERTEX_INDEX_LOCK_IDX, false});
+            container_impl->release_lock_shared({vertex, false});
+#endif
+        }
+
+        template<typename F>
+        void read_vertices(uint64_t vtx_a, uint64_t vtx_b, F&& read) const {
+#ifdef ENABLE_OPTIMISTIC_READ
+            if (auto slot = optimistic::my_slot()) {
+                auto &version_a = container_impl->get_version(vtx_a);
+                auto &version_b = container_impl->get_version(vtx_b);
+                for (unsigned k = 0; k < optimistic::MAX_RETRIES; k++) {
+                    if (slot->enter(0, version_a, lock_table::order_of(vtx_a))) {
+                        optimistic::Leave leave_a{slot, 0};
+                        if (slot->enter(1, version_b, lock_table::order_of(vtx_b))) {
+                            optimistic::Leave leave_b{slot, 1};
+                            read();
+                            return;
+                        }
+                    }
+                    RWSpinLock::yield(k);
+                }
+            }
+#endif
+#ifdef ENABLE_LOCK
+            // in the order writers take them, otherwise a writer holding one waits for us forever
+            if (lock_table::order_of(vtx_b) < lock_table::order_of(vtx_a)) std::swap(vtx_a, vtx_b);
+            container_impl->acquire_lock_shared({vtx_a, false});
+            container_impl->acquire_lock_shared({vtx_b, false});
+#endif
+            read();
+#ifdef ENABLE_LOCK
+            container_impl->release_lock_shared({vtx_a, false});
+            container_impl->release_lock_shared({vtx_b, false});
+#endif
+        }
     };
 
     /// Write transaction, Single writer
+    ///
+    /// The update vectors come from a pool of the thread and go back to it, emptied but with their
+    /// capacity, once the transaction is destroyed. A thread that keeps committing small
+    /// transactions therefore stops allocating for them after its first few.
     template<typename Container>
     struct WriteTransaction {
+#ifdef ENABLE_WEIGHT
+        struct InsertedEdge {
+            uint64_t first;
+            uint64_t second;
+            double weight;
+        };
+#else
+        using InsertedEdge = PUU;
+#endif
+
+    private:
+        // vectors that grew beyond this are freed instead of pooled
+        static constexpr size_t MAX_POOLED_CAPACITY = 1 << 12;
+
+        struct Buffers {
+#ifdef ENABLE_LOCK
+            std::vector<container::RequiredLock> locks_required;
+#endif
+            std::vector<uint64_t> vertex_insert_vec;
+            std::vector<InsertedEdge> edge_insert_vec;
+            std::vector<PUU> edge_delete_vec;
+            Buffers* next = nullptr;
+
+            void clear() {
+#ifdef ENABLE_LOCK
+                reset(locks_required);
+#endif
+                reset(vertex_insert_vec);
+                reset(edge_insert_vec);
+                reset(edge_delete_vec);
+            }
+
+            template<typename T>
+            static void reset(std::vector<T> &vec) {
+                if (vec.capacity() > MAX_POOLED_CAPACITY) std::vector<T>().swap(vec);
+                else vec.clear();
+            }
+        };
+
+        struct Pool {
+            Buffers* free = nullptr;
+
+            ~Pool() {
+                while (free) {
+                    auto next = free->next;
+                    delete free;
+                    free = next;
+                }
+            }
+        };
+
+        static Pool& local_pool() {
+            static thread_local Pool pool;
+            return pool;
+        }
+
+        static Buffers* acquire() {
+            auto &pool = local_pool();
+            if (pool.free == nullptr) return new Buffers();
+            auto buffers = pool.free;
+            pool.free = buffers->next;
+            return buffers;
+        }
+
+        static void release(Buffers* buffers) {
+            auto &pool = local_pool();
+            buffers->clear();
+            buffers->next = pool.free;
+            pool.free = buffers;
+        }
+
+        Buffers* buffers;
+
+    public:
         Container* container_impl;
         TransactionManager<Container>* tm;
 
 #ifdef ENABLE_LOCK
-        std::vector<container::RequiredLock> locks_required{};    // exclusive locks
+        std::vector<container::RequiredLock> &locks_required;     // exclusive locks
 #endif
-        std::vector<uint64_t> vertex_insert_vec{};
-        std::vector<PUU> edge_insert_vec{};
+        std::vector<uint64_t> &vertex_insert_vec;
+        std::vector<InsertedEdge> &edge_insert_vec;
+        std::vector<PUU> &edge_delete_vec;
 
         uint64_t timestamp;
 
         // Functions
-        WriteTransaction(Container* container_impl, TransactionManager<Container>* tm): container_impl(container_impl), tm(tm), timestamp(0) {}
+        WriteTransaction(Container* container_impl, TransactionManager<Container>* tm) : WriteTransaction(acquire(), container_impl, tm) {}
+
+        WriteTransaction(WriteTransaction &&other) : WriteTransaction(other.buffers, other.container_impl, other.tm) {
+            timestamp = other.timestamp;
+            other.buffers = nullptr;
+        }
+
+        WriteTransaction(const WriteTransaction &) = delete;
+        WriteTransaction& operator=(const WriteTransaction &) = delete;
+
+        ~WriteTransaction() {
+            if (buffers) release(buffers);
+        }
 
         void insert_vertex(uint64_t vertex) {
 #ifdef ENABLE_LOCK
@@ -256,12 +560,24 @@ namespace container {
         }
 
         /// Note: the src. and dest. must been inserted transaction where the edge is inserted
-        void insert_edge(uint64_t source, uint64_t destination) {
+        void insert_edge(uint64_t source, uint64_t destination, double weight = 0.0) {
 #ifdef ENABLE_LOCK
             // locks_required.push_back({container::config::VERTEX_INDEX_LOCK_IDX, false});
             locks_required.push_back({source, true});
 #endif
+#ifdef ENABLE_WEIGHT
+            edge_insert_vec.push_back({source, destination, weight});
+#else
             edge_insert_vec.emplace_back(source, destination);
+#endif
+        }
+
+        /// Note: deletions are applied after all insertions of the transaction
+        void remove_edge(uint64_t source, uint64_t destination) {
+#ifdef ENABLE_LOCK
+            locks_required.push_back({source, true});
+#endif
+            edge_delete_vec.emplace_back(source, destination);
         }
 
         /// Hazard! This function is not thread-safe
@@ -270,22 +586,54 @@ namespace container {
         }
 
 #ifdef ENABLE_LOCK 
+        // locks that share a stripe are taken once, through the first vertex mapped to it
         void sort_and_unique() {
             std::sort(locks_required.begin(), locks_required.end(), [](const container::RequiredLock& a, const container::RequiredLock& b) {
-                return a.idx < b.idx;
+                return lock_table::order_of(a.idx) < lock_table::order_of(b.idx);
             });
             locks_required.erase(std::unique(locks_required.begin(), locks_required.end(), [](const container::RequiredLock& a, const container::RequiredLock& b) {
-                return a.idx == b.idx;
+                return lock_table::order_of(a.idx) == lock_table::order_of(b.idx);
             }), locks_required.end());
         }
 #endif
 
         bool commit() {
+            acquire_locks();
+#ifdef ENABLE_GROUP_COMMIT
+            timestamp = tm->commit_groups.join(tm->global_timestamp);
+            {
+                CommitGroups::Member member{tm->commit_groups, timestamp};
+                apply();
+            }
+            release_locks();
+            tm->commit_groups.publish(tm->global_timestamp, timestamp);
+#else
+            timestamp = tm->global_timestamp.fetch_add(1) + 1;
+            apply();
+            release_locks();
+#endif
+            return true;
+        }
+
+        void abort() {
+        }
+
+    private:
+        WriteTransaction(Buffers* buffers, Container* container_impl, TransactionManager<Container>* tm)
+            : buffers(buffers), container_impl(container_impl), tm(tm),
+#ifdef ENABLE_LOCK
+              locks_required(buffers->locks_required),
+#endif
+              vertex_insert_vec(buffers->vertex_insert_vec), edge_insert_vec(buffers->edge_insert_vec),
+              edge_delete_vec(buffers->edge_delete_vec), timestamp(0) {}
+
+        void acquire_locks() {
 #ifdef ENABLE_LOCK
             if (locks_required.size() == 2) {
-                if (locks_required[0].idx == locks_required[1].idx) {
+                uint64_t first = lock_table::order_of(locks_required[0].idx), second = lock_table::order_of(locks_required[1].idx);
+                if (first == second) {
                     locks_required.pop_back();  // Remove the duplicate
-                } else if (locks_required[0].idx > locks_required[1].idx) {
+                } else if (first > second) {
                     // If they are not equal, sort them in ascending order
                     std::swap(locks_required[0].idx, locks_required[1].idx);
                 }
@@ -294,8 +642,15 @@ namespace container {
             else if (locks_required.size() > 2) sort_and_unique();
             container_impl->acquire_locks(locks_required);
 #endif
+        }
 
-            timestamp = tm->global_timestamp.fetch_add(1) + 1;
+        void release_locks() {
+#ifdef ENABLE_LOCK
+            container_impl->release_locks(locks_required);
+#endif
+        }
+
+        void apply() {
             // insert vertex
             for (auto& vertex: vertex_insert_vec) {
                 if (!container_impl->insert_vertex(vertex, timestamp)) {
@@ -304,40 +659,79 @@ namespace container {
             }
 
             // insert single edge
-            if (edge_insert_vec.empty()) return true;
-            else if (edge_insert_vec.size() <= 2) { // TODO: change this ugly hardcode
+            if (edge_insert_vec.size() <= 2) { // TODO: change this ugly hardcode
                 for (auto & edge : edge_insert_vec) {
-                    if (!container_impl->insert_edge(edge.first, edge.second, timestamp)) {
+                    if (!container_impl->insert_edge(edge.first, edge.second, timestamp, edge_weight(edge))) {
                         std::cerr << "edge exists: transaction_2pl::insert_edge: " << edge.first << ' ' << edge.second << std::endl;
                     }
                 }
             }
             // batch insert
-            else {
-                std::sort(edge_insert_vec.begin(), edge_insert_vec.end(), [] (const PUU& a, const PUU& b) {
-                    if (a.first == b.first) return a.second < b.second;
-                    else return a.first < b.first;
-                });
+            else if (config::PARALLEL_COMMIT_SIZE == 0 || edge_insert_vec.size() < config::PARALLEL_COMMIT_SIZE) {
+                std::sort(edge_insert_vec.begin(), edge_insert_vec.end(), edge_less);
                 
                 auto iter = edge_insert_vec.begin();
                 while (iter != edge_insert_vec.end()) {
-                    uint64_t cur_src = iter->first;
-                    std::vector<uint64_t> dest_list;
-                    while (iter != edge_insert_vec.end() && iter->first == cur_src) {
-                        dest_list.push_back(iter->second);
-                        iter++;
-                    }
-                    container_impl->insert_edge_batch(cur_src, dest_list, timestamp);
+                    auto next = iter;
+                    while (next != edge_insert_vec.end() && next->first == iter->first) next++;
+                    insert_source(iter, next);
+                    iter = next;
                 }
             }
+            // all sources are locked and independent of each other, insert them in parallel
+            else {
+                tbb::parallel_sort(edge_insert_vec.begin(), edge_insert_vec.end(), edge_less);
 
-#ifdef ENABLE_LOCK
-            container_impl->release_locks(locks_required);
+                std::vector<size_t> starts;
+                for (size_t i = 0; i < edge_insert_vec.size(); i++) {
+                    if (i == 0 || edge_insert_vec[i].first != edge_insert_vec[i - 1].first) starts.push_back(i);
+                }
+                starts.push_back(edge_insert_vec.size());
+                tbb::parallel_for(size_t(0), starts.size() - 1, [&] (size_t run) {
+                    insert_source(edge_insert_vec.begin() + starts[run], edge_insert_vec.begin() + starts[run + 1]);
+                });
+            }
+
+            // remove edge
+            for (auto & edge : edge_delete_vec) {
+                if (!container_impl->remove_edge(edge.first, edge.second, timestamp)) {
+                    std::cerr << "edge does not exist: transaction_2pl::remove_edge: " << edge.first << ' ' << edge.second << std::endl;
+                }
+            }
+        }
+
+        // [begin, end) are the sorted edges of one source
+        //
+        // The scratch lists here and in the edge indexes are thread_local, and the indexes run nested
+        // parallel loops for big batches. Isolation keeps a thread waiting in such a loop from picking
+        // up another source, which would refill the lists still being read.
+        void insert_source(typename std::vector<InsertedEdge>::const_iterator begin, typename std::vector<InsertedEdge>::const_iterator end) {
+            tbb::this_task_arena::isolate([&] {
+                static thread_local std::vector<uint64_t> dest_list;
+                static thread_local std::vector<double> weight_list;
+                dest_list.clear();
+                weight_list.clear();
+                for (auto iter = begin; iter != end; iter++) {
+                    dest_list.push_back(iter->second);
+#ifdef ENABLE_WEIGHT
+                    weight_list.push_back(iter->weight);
 #endif
-            return true;
+                }
+                container_impl->insert_edge_batch(begin->first, dest_list, timestamp, weight_list);
+            });
         }
 
-        void abort() {
+        static bool edge_less(const InsertedEdge& a, const InsertedEdge& b) {
+            if (a.first == b.first) return a.second < b.second;
+            else return a.first < b.first;
+        }
+
+        static double edge_weight(const InsertedEdge &edge) {
+#ifdef ENABLE_WEIGHT
+            return edge.weight;
+#else
+            return 0.0;
+#endif
         }
     };
 }
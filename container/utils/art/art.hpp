@@ -1,2 +1,489 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <limits>
+#include <algorithm>
+#include <emmintrin.h>
+
+#include "../rwlock.hpp"
+
+namespace container::art {
+    /// Adaptive radix tree over 64-bit keys with optimistic lock coupling (Leis et al., DaMoN'16).
+    ///
+    /// Readers never write shared memory: they remember the version of every node they pass and
+    /// restart if it changed underneath them. Writers lock only the node they modify (and its parent
+    /// when the node is replaced). Keys are split into 8 big-endian bytes so the tree is ordered;
+    /// values always hang below the last byte and paths are compressed by storing the full prefix
+    /// in the node. The tree is insert-only, nodes replaced by growth are retired rather than freed
+    /// because a reader may still be inside them, and only released by clear().
+    template<typename T>
+    class Tree {
+        static constexpr uint32_t KEY_BYTES = 8;
+        static constexpr uint32_t LAST_BYTE = KEY_BYTES - 1;
+
+        enum NodeType : uint8_t { N4 = 0, N16 = 1, N48 = 2, N256 = 3 };
+
+        struct Node {
+            // bit 0: obsolete, bit 1: locked, the rest counts the write locks taken so far
+            std::atomic<uint64_t> version{0b100};
+            NodeType type;
+            uint8_t prefix_len = 0;
+            uint16_t count = 0;
+            uint8_t prefix[KEY_BYTES] = {};
+
+            explicit Node(NodeType type) : type(type) {}
+
+            static bool is_locked(uint64_t version) { return version & 0b10; }
+            static bool is_obsolete(uint64_t version) { return version & 0b1; }
+
+            uint64_t read_lock_or_restart(bool &restart) const {
+                uint64_t v = version.load(std::memory_order_acquire);
+                for (unsigned k = 0; is_locked(v); k++) {
+                    RWSpinLock::yield(k);
+                    v = version.load(std::memory_order_acquire);
+                }
+                if (is_obsolete(v)) restart = true;
+                return v;
+            }
+
+            void check_or_restart(uint64_t v, bool &restart) const {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (version.load(std::memory_order_relaxed) != v) restart = true;
+            }
+
+            void upgrade_to_write_lock_or_restart(uint64_t &v, bool &restart) {
+                if (version.compare_exchange_strong(v, v + 0b10, std::memory_order_acquire)) {
+                    v += 0b10;
+                } else {
+                    restart = true;
+                }
+            }
+
+            void write_unlock() { version.fetch_add(0b10, std::memory_order_release); }
+            void write_unlock_obsolete() { version.fetch_add(0b11, std::memory_order_release); }
+        };
+
+        // N4 and N16 keep their keys sorted, so every node hands out its children in key order
+        struct Node4 : Node {
+            uint8_t keys[4];
+            void* children[4];
+            Node4() : Node(N4) {}
+        };
+
+        struct Node16 : Node {
+            uint8_t keys[16];
+            void* children[16];
+            Node16() : Node(N16) {}
+        };
+
+        struct Node48 : Node {
+            static constexpr uint8_t EMPTY = 48;
+            uint8_t child_index[256];
+            void* children[48];
+            Node48() : Node(N48) { std::memset(child_index, EMPTY, sizeof(child_index)); }
+        };
+
+        struct Node256 : Node {
+            void* children[256] = {};
+            Node256() : Node(N256) {}
+        };
+
+    public:
+        Tree() : m_root(new Node256()) {}
+
+        ~Tree() {
+            clear();
+            delete static_cast<Node256*>(m_root);
+        }
+
+        Tree(const Tree&) = delete;
+        Tree& operator=(const Tree&) = delete;
+
+        T* find(uint64_t key) const {
+        restart:
+            bool restart = false;
+            const Node* node = m_root;
+            uint64_t v = node->read_lock_or_restart(restart);
+            if (restart) goto restart;
+            for (uint32_t depth = 0; ; depth++) {
+                uint32_t prefix_len = node->prefix_len;
+                if (depth + prefix_len > LAST_BYTE || prefix_mismatch(node, key, depth, prefix_len) != prefix_len) {
+                    node->check_or_restart(v, restart);
+                    if (restart) goto restart;
+                    return nullptr;
+                }
+                depth += prefix_len;
+                void* child = get_child(node, key_byte(key, depth));
+                node->check_or_restart(v, restart);
+                if (restart) goto restart;
+                if (child == nullptr) return nullptr;
+                if (depth == LAST_BYTE) return static_cast<T*>(child);
+
+                // the parent must not have changed before the child's version was read
+                const Node* parent = node;
+                uint64_t parent_version = v;
+                node = static_cast<const Node*>(child);
+                v = node->read_lock_or_restart(restart);
+                if (restart) goto restart;
+                parent->check_or_restart(parent_version, restart);
+                if (restart) goto restart;
+            }
+        }
+
+        /// Inserts value under key unless the key is present, returns whether it was inserted
+        bool insert(uint64_t key, T* value) {
+        restart:
+            bool restart = false;
+            Node* node = nullptr;
+            Node* next = m_root;
+            Node* parent = nullptr;
+            uint8_t parent_key = 0, node_key = 0;
+            uint64_t parent_version = 0;
+
+            for (uint32_t depth = 0; ; depth++) {
+                parent = node;
+                parent_key = node_key;
+                node = next;
+                uint64_t v = node->read_lock_or_restart(restart);
+                if (restart) goto restart;
+
+                uint32_t prefix_len = node->prefix_len;
+                if (depth + prefix_len > LAST_BYTE) {
+                    // only a torn read gets here
+                    node->check_or_restart(v, restart);
+                    goto restart;
+                }
+                uint32_t mismatch = prefix_mismatch(node, key, depth, prefix_len);
+                if (mismatch != prefix_len) {
+                    // the key leaves the compressed path: a new node takes over the common part
+                    parent->upgrade_to_write_lock_or_restart(parent_version, restart);
+                    if (restart) goto restart;
+                    node->upgrade_to_write_lock_or_restart(v, restart);
+                    if (restart) {
+                        parent->write_unlock();
+                        goto restart;
+                    }
+                    auto split = new Node4();
+                    split->prefix_len = mismatch;
+                    std::memcpy(split->prefix, node->prefix, mismatch);
+                    insert_child(split, node->prefix[mismatch], node);
+                    insert_child(split, key_byte(key, depth + mismatch), make_path(key, depth + mismatch + 1, value));
+
+                    node->prefix_len -= mismatch + 1;
+                    std::memmove(node->prefix, node->prefix + mismatch + 1, node->prefix_len);
+                    change_child(parent, parent_key, split);
+
+                    node->write_unlock();
+                    parent->write_unlock();
+                    return true;
+                }
+
+                depth += prefix_len;
+                node_key = key_byte(key, depth);
+                next = static_cast<Node*>(get_child(node, node_key));
+                node->check_or_restart(v, restart);
+                if (restart) goto restart;
+
+                if (next == nullptr) {
+                    insert_and_unlock(node, v, parent, parent_version, parent_key, node_key, key, depth + 1, value, restart);
+                    if (restart) goto restart;
+                    return true;
+                }
+                if (depth == LAST_BYTE) return false;
+
+                if (parent) {
+                    parent->check_or_restart(parent_version, restart);
+                    if (restart) goto restart;
+                }
+                parent_version = v;
+            }
+        }
+
+        /// Visits the keys in [lo, hi] in ascending order until the callback returns false
+        template<typename F>
+        void scan(uint64_t lo, uint64_t hi, F &&callback) const {
+            uint64_t from = lo;
+            while (from <= hi) {
+                bool restart = false;
+                scan_node(m_root, 0, 0, from, hi, callback, restart);
+                // keys before from have been handed out already, continue behind them
+                if (!restart) return;
+            }
+        }
+
+        template<typename F>
+        void scan(F &&callback) const {
+            scan(0, std::numeric_limits<uint64_t>::max(), callback);
+        }
+
+        /// Hazard! Not thread-safe, the values are left to the caller
+        void clear() {
+            auto root = static_cast<Node256*>(m_root);
+            for (auto &child : root->children) {
+                if (child) free_node(static_cast<Node*>(child), 1);
+                child = nullptr;
+            }
+            root->count = 0;
+            for (auto node : m_retired) delete_node(node);
+            m_retired.clear();
+        }
+
+    private:
+        static uint8_t key_byte(uint64_t key, uint32_t depth) {
+            return key >> (8 * (LAST_BYTE - depth));
+        }
+
+        // prefix_len is passed in, it was read once and checked against depth by the caller
+        static uint32_t prefix_mismatch(const Node* node, uint64_t key, uint32_t depth, uint32_t prefix_len) {
+            uint32_t i = 0;
+            while (i < prefix_len && node->prefix[i] == key_byte(key, depth + i)) i++;
+            return i;
+        }
+
+        // the remaining bytes of key below depth, a compressed node in front of the value
+        static void* make_path(uint64_t key, uint32_t depth, T* value) {
+            if (depth == KEY_BYTES) return value;
+            auto node = new Node4();
+            node->prefix_len = LAST_BYTE - depth;
+            for (uint32_t i = 0; i < node->prefix_len; i++) node->prefix[i] = key_byte(key, depth + i);
+            insert_child(node, key_byte(key, LAST_BYTE), value);
+            return node;
+        }
+
+        static void* get_child(const Node* node, uint8_t byte) {
+            switch (node->type) {
+                case N4: {
+                    auto n = static_cast<const Node4*>(node);
+                    for (uint32_t i = 0; i < n->count && i < 4; i++) {
+                        if (n->keys[i] == byte) return n->children[i];
+                    }
+                    return nullptr;
+                }
+                case N16: {
+                    auto n = static_cast<const Node16*>(node);
+                    __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8(byte), _mm_loadu_si128(reinterpret_cast<const __m128i*>(n->keys)));
+                    uint32_t mask = _mm_movemask_epi8(cmp) & ((1u << std::min<uint32_t>(n->count, 16)) - 1);
+                    return mask ? n->children[__builtin_ctz(mask)] : nullptr;
+                }
+                case N48: {
+                    auto n = static_cast<const Node48*>(node);
+                    uint8_t idx = n->child_index[byte];
+                    return idx < Node48::EMPTY ? n->children[idx] : nullptr;
+                }
+                case N256:
+                    return static_cast<const Node256*>(node)->children[byte];
+            }
+            return nullptr;
+        }
+
+        static bool is_full(const Node* node) {
+            switch (node->type) {
+                case N4: return node->count == 4;
+                case N16: return node->count == 16;
+                case N48: return node->count == 48;
+                case N256: return false;
+            }
+            return false;
+        }
+
+        static void insert_child(Node* node, uint8_t byte, void* child) {
+            switch (node->type) {
+                case N4: insert_sorted(static_cast<Node4*>(node), byte, child); break;
+                case N16: insert_sorted(static_cast<Node16*>(node), byte, child); break;
+                case N48: {
+                    auto n = static_cast<Node48*>(node);
+                    n->children[n->count] = child;
+                    n->child_index[byte] = n->count;
+                    n->count++;
+                    break;
+                }
+                case N256: {
+                    auto n = static_cast<Node256*>(node);
+                    n->children[byte] = child;
+                    n->count++;
+                    break;
+                }
+            }
+        }
+
+        template<typename N>
+        static void insert_sorted(N* node, uint8_t byte, void* child) {
+            uint32_t pos = 0;
+            while (pos < node->count && node->keys[pos] < byte) pos++;
+            std::memmove(node->keys + pos + 1, node->keys + pos, node->count - pos);
+            std::memmove(node->children + pos + 1, node->children + pos, (node->count - pos) * sizeof(void*));
+            node->keys[pos] = byte;
+            node->children[pos] = child;
+            node->count++;
+        }
+
+        static void change_child(Node* node, uint8_t byte, void* child) {
+            switch (node->type) {
+                case N4: {
+                    auto n = static_cast<Node4*>(node);
+                    for (uint32_t i = 0; i < n->count; i++) if (n->keys[i] == byte) n->children[i] = child;
+                    break;
+                }
+                case N16: {
+                    auto n = static_cast<Node16*>(node);
+                    for (uint32_t i = 0; i < n->count; i++) if (n->keys[i] == byte) n->children[i] = child;
+                    break;
+                }
+                case N48: {
+                    auto n = static_cast<Node48*>(node);
+                    n->children[n->child_index[byte]] = child;
+                    break;
+                }
+                case N256:
+                    static_cast<Node256*>(node)->children[byte] = child;
+                    break;
+            }
+        }
+
+        // copies the children of node into buffer in key order, returns how many there are
+        static uint32_t collect(const Node* node, std::pair<uint8_t, void*>* buffer) {
+            uint32_t num = 0;
+            switch (node->type) {
+                case N4: {
+                    auto n = static_cast<const Node4*>(node);
+                    for (uint32_t i = 0; i < n->count && i < 4; i++) buffer[num++] = {n->keys[i], n->children[i]};
+                    break;
+                }
+                case N16: {
+                    auto n = static_cast<const Node16*>(node);
+                    for (uint32_t i = 0; i < n->count && i < 16; i++) buffer[num++] = {n->keys[i], n->children[i]};
+                    break;
+                }
+                case N48: {
+                    auto n = static_cast<const Node48*>(node);
+                    for (uint32_t b = 0; b < 256; b++) {
+                        uint8_t idx = n->child_index[b];
+                        if (idx < Node48::EMPTY) buffer[num++] = {uint8_t(b), n->children[idx]};
+                    }
+                    break;
+                }
+                case N256: {
+                    auto n = static_cast<const Node256*>(node);
+                    for (uint32_t b = 0; b < 256; b++) {
+                        if (n->children[b]) buffer[num++] = {uint8_t(b), n->children[b]};
+                    }
+                    break;
+                }
+            }
+            return num;
+        }
+
+        static Node* grow(const Node* node) {
+            Node* bigger;
+            switch (node->type) {
+                case N4: bigger = new Node16(); break;
+                case N16: bigger = new Node48(); break;
+                default: bigger = new Node256(); break;
+            }
+            bigger->prefix_len = node->prefix_len;
+            std::memcpy(bigger->prefix, node->prefix, KEY_BYTES);
+            std::pair<uint8_t, void*> buffer[256];
+            uint32_t num = collect(node, buffer);
+            for (uint32_t i = 0; i < num; i++) insert_child(bigger, buffer[i].first, buffer[i].second);
+            return bigger;
+        }
+
+        // the path below byte is only built once the locks are held, a restart leaves nothing behind
+        void insert_and_unlock(Node* node, uint64_t v, Node* parent, uint64_t parent_version, uint8_t parent_key, uint8_t byte,
+                               uint64_t key, uint32_t depth, T* value, bool &restart) {
+            if (!is_full(node)) {
+                if (parent) {
+                    parent->check_or_restart(parent_version, restart);
+                    if (restart) return;
+                }
+                node->upgrade_to_write_lock_or_restart(v, restart);
+                if (restart) return;
+                insert_child(node, byte, make_path(key, depth, value));
+                node->write_unlock();
+                return;
+            }
+
+            // a full node is replaced by a bigger copy, which needs the parent to swing its pointer
+            parent->upgrade_to_write_lock_or_restart(parent_version, restart);
+            if (restart) return;
+            node->upgrade_to_write_lock_or_restart(v, restart);
+            if (restart) {
+                parent->write_unlock();
+                return;
+            }
+            auto bigger = grow(node);
+            insert_child(bigger, byte, make_path(key, depth, value));
+            change_child(parent, parent_key, bigger);
+            node->write_unlock_obsolete();
+            parent->write_unlock();
+
+            std::lock_guard<std::mutex> guard(m_retired_mutex);
+            m_retired.push_back(node);
+        }
+
+        template<typename F>
+        static bool scan_node(const Node* node, uint32_t depth, uint64_t key, uint64_t &from, uint64_t hi, F &callback, bool &restart,
+                              const Node* parent = nullptr, uint64_t parent_version = 0) {
+            uint64_t v = node->read_lock_or_restart(restart);
+            if (restart) return false;
+            // the parent must not have changed before the node's version was read
+            if (parent) {
+                parent->check_or_restart(parent_version, restart);
+                if (restart) return false;
+            }
+            uint32_t prefix_len = node->prefix_len;
+            for (uint32_t i = 0; i < prefix_len && depth + i <= LAST_BYTE; i++) {
+                key |= uint64_t(node->prefix[i]) << (8 * (LAST_BYTE - depth - i));
+            }
+            std::pair<uint8_t, void*> buffer[256];
+            uint32_t num = collect(node, buffer);
+            node->check_or_restart(v, restart);
+            if (restart || depth + prefix_len > LAST_BYTE) return restart = true, false;
+
+            depth += prefix_len;
+            uint32_t shift = 8 * (LAST_BYTE - depth);
+            for (uint32_t i = 0; i < num; i++) {
+                uint64_t child_key = key | (uint64_t(buffer[i].first) << shift);
+                uint64_t child_max = child_key | ((uint64_t(1) << shift) - 1);
+                if (child_max < from) continue;
+                if (child_key > hi) return false;
+                if (depth == LAST_BYTE) {
+                    if (!callback(child_key, static_cast<T*>(buffer[i].second)) || child_key == hi) return false;
+                    from = child_key + 1;
+                } else if (!scan_node(static_cast<const Node*>(buffer[i].second), depth + 1, child_key, from, hi, callback, restart, node, v)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static void delete_node(Node* node) {
+            switch (node->type) {
+                case N4: delete static_cast<Node4*>(node); break;
+                case N16: delete static_cast<Node16*>(node); break;
+                case N48: delete static_cast<Node48*>(node); break;
+                case N256: delete static_cast<Node256*>(node); break;
+            }
+        }
+
+        static void free_node(Node* node, uint32_t depth) {
+            // depth is the byte the children hang off, below the last byte they are values
+            depth += node->prefix_len;
+            if (depth < LAST_BYTE) {
+                std::pair<uint8_t, void*> buffer[256];
+                uint32_t num = collect(node, buffer);
+                for (uint32_t i = 0; i < num; i++) free_node(static_cast<Node*>(buffer[i].second), depth + 1);
+            }
+            delete_node(node);
+        }
+
+        Node* m_root;
+        std::mutex m_retired_mutex;
+        std::vector<Node*> m_retired;
+    };
+}
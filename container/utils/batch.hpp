@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace container::batch {
+    // sorts a batch of destinations, the weights (if there are any) follow their destination
+    inline void sort(std::vector<uint64_t> &dests, std::vector<double> &weights) {
+        if (weights.empty()) {
+            std::sort(dests.begin(), dests.end());
+            return;
+        }
+        std::vector<size_t> order(dests.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&dests] (size_t a, size_t b) {
+            return dests[a] < dests[b];
+        });
+        std::vector<uint64_t> sorted_dests(dests.size());
+        std::vector<double> sorted_weights(weights.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            sorted_dests[i] = dests[order[i]];
+            sorted_weights[i] = weights[order[i]];
+        }
+        dests.swap(sorted_dests);
+        weights.swap(sorted_weights);
+    }
+}
@@ -12,6 +12,38 @@ namespace container::config {
 
     static size_t DEFAULT_VECTOR_SIZE = DEFAULT_VECTOR_SIZE_VALUE;  // In entry num;
 
+#ifndef INLINE_EDGES_VALUE
+#define INLINE_EDGES_VALUE 0
+#endif
+    // edges a vertex keeps inside its entry before allocating a NeighborEntry, 0 always allocates
+    // and keeps no inline slots, so the vertex entry does not grow unless a target opts in
+    constexpr uint32_t INLINE_EDGES = INLINE_EDGES_VALUE;
+
+#ifndef LOCK_STRIPES_BITS_VALUE
+#define LOCK_STRIPES_BITS_VALUE 16
+#endif
+    // with ENABLE_LOCK_STRIPING, vertices share 2^LOCK_STRIPES_BITS locks instead of owning one each
+    constexpr uint32_t LOCK_STRIPES_BITS = LOCK_STRIPES_BITS_VALUE;
+
+    // adaptive neighborhoods of at least this many edges may switch to a hash index, 0 disables it
+    static size_t HASH_NEIGHBOR_SIZE = 0;
+
+    // and do so once they have seen at least this many lookups per write
+    static double HASH_READ_RATIO = 1.0;
+
+    // gc of the 2PL containers runs this often, in milliseconds
+    static uint64_t GC_INTERVAL_MS = 5000;
+
+    // workers sharing a gc pass, each takes GC_SLICE dirty vertices at a time
+    static uint32_t GC_WORKERS = 1;
+    static uint64_t GC_SLICE = 1024;
+
+    // writers needing a newer snapshot bound than the one gc left rescan the readers at most this often, in microseconds
+    static uint64_t SNAPSHOT_REFRESH_US = 1000;
+
+    // 2PL write transactions inserting at least this many edges sort and apply them in parallel, 0 never does
+    static uint64_t PARALLEL_COMMIT_SIZE = 1 << 14;
+
     static uint64_t MEMORY_SIZE = 1ull << 33;
     static uint64_t ELEMENTS_NUM = MEMORY_SIZE / 8;
 }
\ No newline at end of file
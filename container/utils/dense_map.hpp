@@ -0,0 +1,4 @@
+#pragma once
+
+// The ankerl maps, shared by the hash indexes and the dirty vertex set.
+#include "unordered_dense/include/ankerl/unordered_dense.h"
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <utility>
+#include "rwlock.hpp"
+#include "dense_map.hpp"
+
+namespace container {
+    /// Vertices written since gc last looked at them, each with the newest timestamp it got
+    ///
+    /// Writers record a vertex while they hold its lock, so the set is sharded like the hash vertex
+    /// index and two writers only meet on a shard lock. gc takes the whole set at once and puts back
+    /// the vertices that still carry versions no snapshot bound could drop yet.
+    struct DirtySet {
+        static constexpr uint32_t SHARD_BITS = 6;
+        static constexpr uint32_t NUM_SHARDS = 1u << SHARD_BITS;
+
+        void add(uint64_t vertex, uint64_t timestamp) {
+            auto &shard = shard_of(vertex);
+            std::lock_guard<RWSpinLock> guard(shard.lock);
+            auto [iter, inserted] = shard.map.try_emplace(vertex, timestamp);
+            if (!inserted && iter->second < timestamp) iter->second = timestamp;
+        }
+
+        // moves the recorded (vertex, newest timestamp) pairs into dirty, the set is empty afterwards
+        void take(std::vector<std::pair<uint64_t, uint64_t>> &dirty) {
+            for (auto &shard : m_shards) {
+                ankerl::unordered_dense::map<uint64_t, uint64_t> map;
+                {
+                    std::lock_guard<RWSpinLock> guard(shard.lock);
+                    std::swap(map, shard.map);
+                }
+                dirty.insert(dirty.end(), map.begin(), map.end());
+            }
+        }
+
+    private:
+        struct alignas(64) Shard {
+            RWSpinLock lock;
+            ankerl::unordered_dense::map<uint64_t, uint64_t> map;
+
+            // same -Wstringop-overflow false positive as the shards of HashmapVertexIndex
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstringop-overflow"
+#endif
+            Shard() : map() {}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+        };
+
+        Shard& shard_of(uint64_t vertex) {
+            return m_shards[(vertex * 0x9E3779B97F4A7C15ull) >> (64 - SHARD_BITS)];
+        }
+
+        Shard m_shards[NUM_SHARDS];
+    };
+}
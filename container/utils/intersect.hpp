@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include <type_traits>
+#include <immintrin.h>
+
+namespace container::intersect {
+    // a list at least this many times longer than the other is searched instead of merged
+    static constexpr size_t GALLOP_RATIO = 32;
+
+    inline uint64_t merge_scalar(const uint64_t* a, size_t na, const uint64_t* b, size_t nb) {
+        uint64_t sum = 0;
+        size_t i = 0, j = 0;
+        while (i < na && j < nb) {
+            if (a[i] < b[j]) i++;
+            else if (a[i] > b[j]) j++;
+            else {
+                sum++;
+                i++;
+                j++;
+            }
+        }
+        return sum;
+    }
+
+    // compares blocks of 4 against all rotations of each other, then advances the block with the smaller maximum
+    inline uint64_t merge(const uint64_t* a, size_t na, const uint64_t* b, size_t nb) {
+        uint64_t sum = 0;
+        size_t i = 0, j = 0;
+#ifdef __AVX2__
+        while (i + 4 <= na && j + 4 <= nb) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+            __m256i mask = _mm256_cmpeq_epi64(va, vb);
+            vb = _mm256_permute4x64_epi64(vb, 0x39);
+            mask = _mm256_or_si256(mask, _mm256_cmpeq_epi64(va, vb));
+            vb = _mm256_permute4x64_epi64(vb, 0x39);
+            mask = _mm256_or_si256(mask, _mm256_cmpeq_epi64(va, vb));
+            vb = _mm256_permute4x64_epi64(vb, 0x39);
+            mask = _mm256_or_si256(mask, _mm256_cmpeq_epi64(va, vb));
+            sum += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+
+            uint64_t max_a = a[i + 3], max_b = b[j + 3];
+            if (max_a <= max_b) i += 4;
+            if (max_b <= max_a) j += 4;
+        }
+#endif
+        return sum + merge_scalar(a + i, na - i, b + j, nb - j);
+    }
+
+    // exponential search of every element of small in large, resuming from the previous hit
+    inline uint64_t gallop(const uint64_t* small, size_t ns, const uint64_t* large, size_t nl) {
+        uint64_t sum = 0;
+        size_t pos = 0;
+        for (size_t i = 0; i < ns && pos < nl; i++) {
+            uint64_t value = small[i];
+            size_t bound = 1;
+            while (pos + bound < nl && large[pos + bound] < value) bound <<= 1;
+            auto it = std::lower_bound(large + pos + (bound >> 1), large + std::min(pos + bound + 1, nl), value);
+            pos = it - large;
+            if (pos < nl && *it == value) {
+                sum++;
+                pos++;
+            }
+        }
+        return sum;
+    }
+
+    // both lists must be sorted and free of duplicates
+    inline uint64_t sorted(const uint64_t* a, size_t na, const uint64_t* b, size_t nb) {
+        if (na > nb) {
+            std::swap(a, b);
+            std::swap(na, nb);
+        }
+        if (na == 0) return 0;
+        if (nb / na >= GALLOP_RATIO) return gallop(a, na, b, nb);
+        return merge(a, na, b, nb);
+    }
+
+    // per-thread buffers, so intersections do not allocate once they are warm
+    inline std::vector<uint64_t>& buffer(int idx) {
+        thread_local std::vector<uint64_t> buffers[2];
+        return buffers[idx];
+    }
+
+    // fills out with the destinations of index visible at timestamp, in ascending order
+    template<typename Index>
+    void collect(const Index & index, uint64_t timestamp, std::vector<uint64_t> & out) {
+        out.clear();
+        index.edges([&out] (uint64_t dest, double weight) {
+            out.push_back(dest);
+            return true;
+        }, timestamp);
+        if (!std::is_sorted(out.begin(), out.end())) std::sort(out.begin(), out.end());
+    }
+
+    // indexes whose has_edge is sublinear declare static constexpr bool FAST_PROBE = true
+    template<typename Index, typename = void>
+    struct has_fast_probe : std::false_type {};
+
+    template<typename Index>
+    struct has_fast_probe<Index, std::void_t<decltype(Index::FAST_PROBE)>> : std::bool_constant<Index::FAST_PROBE> {};
+
+    // looks every edge of small visible at timestamp up in large, which is never read in full
+    template<typename Small, typename Large>
+    uint64_t probe(const Small & small, const Large & large, uint64_t large_src, uint64_t timestamp) {
+        uint64_t sum = 0;
+        small.edges([&] (uint64_t dest, double weight) {
+            sum += large.has_edge(large_src, dest, timestamp);
+            return true;
+        }, timestamp);
+        return sum;
+    }
+
+    template<typename IndexA, typename IndexB>
+    uint64_t neighbors(const IndexA & a, const IndexB & b, uint64_t timestamp) {
+        auto & dests_a = buffer(0);
+        auto & dests_b = buffer(1);
+        collect(a, timestamp, dests_a);
+        collect(b, timestamp, dests_b);
+        return sorted(dests_a.data(), dests_a.size(), dests_b.data(), dests_b.size());
+    }
+}
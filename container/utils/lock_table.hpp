@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include "rwlock.hpp"
+#include "config.hpp"
+
+namespace container::lock_table {
+    // one lock per cache line, neighbouring stripes never share a line
+    struct alignas(64) Stripe {
+        RWSpinLock lock;
+        std::atomic<uint64_t> version {0};      // for optimistic readers, see optimistic.hpp
+    };
+
+    // the high bits of a multiplicative hash, so vertices with close ids land on different stripes
+    inline uint64_t stripe_of(uint64_t vertex) {
+        return (vertex * 0x9E3779B97F4A7C15ull) >> (64 - config::LOCK_STRIPES_BITS);
+    }
+
+    inline Stripe& stripe(uint64_t vertex) {
+        static Stripe stripes[uint64_t(1) << config::LOCK_STRIPES_BITS];
+        return stripes[stripe_of(vertex)];
+    }
+
+    inline RWSpinLock& get(uint64_t vertex) {
+        return stripe(vertex).lock;
+    }
+
+    // the order locks of a transaction are taken in: with striping two vertices may share a lock,
+    // so transactions order (and deduplicate) by stripe; the index lock always comes last
+    inline uint64_t order_of(uint64_t idx) {
+#ifdef ENABLE_LOCK_STRIPING
+        if (idx == config::VERTEX_INDEX_LOCK_IDX) return idx;
+        return stripe_of(idx);
+#else
+        return idx;
+#endif
+    }
+}
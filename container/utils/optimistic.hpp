@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <limits>
+#include "rwlock.hpp"
+#include "thread_slots.hpp"
+
+namespace container::optimistic {
+    /// Lock-free reads of a vertex (ENABLE_OPTIMISTIC_READ)
+    ///
+    /// Every vertex lock comes with a seqlock-style version, odd while a writer holds the lock.
+    /// A reader announces the vertex in a slot only its own thread writes, checks that the version
+    /// is even and reads; if a writer holds the vertex it backs off and retries. The edge indexes
+    /// free memory while they are modified, so a writer that made the version odd also waits for
+    /// the readers announced on its vertex before it touches anything.
+    constexpr uint32_t MAX_READERS = 256;
+    constexpr uint32_t MAX_RETRIES = 8;
+    constexpr uint64_t NONE = std::numeric_limits<uint64_t>::max();
+
+    struct ReaderSlot {
+        std::atomic<uint64_t> keys[2] {NONE, NONE};
+
+        // false if a writer holds the vertex, the key is withdrawn again
+        bool enter(uint32_t idx, const std::atomic<uint64_t> &version, uint64_t key) {
+            keys[idx].store(key, std::memory_order_seq_cst);
+            if (version.load(std::memory_order_seq_cst) & 1) {
+                keys[idx].store(NONE, std::memory_order_release);
+                return false;
+            }
+            return true;
+        }
+
+        void leave(uint32_t idx) {
+            keys[idx].store(NONE, std::memory_order_release);
+        }
+    };
+
+    // withdraws an announcement once the read is done, also if it throws
+    struct Leave {
+        ReaderSlot* slot;
+        uint32_t idx;
+        ~Leave() { slot->leave(idx); }
+    };
+
+    using ReaderSlots = ThreadSlots<ReaderSlot, MAX_READERS>;
+
+    // nullptr once every slot is taken, such threads keep using the shared locks
+    inline ReaderSlot* my_slot() {
+        return ReaderSlots::mine();
+    }
+
+    // the vertex lock is held exclusively
+    inline void begin_write(std::atomic<uint64_t> &version, uint64_t key) {
+        version.fetch_add(1, std::memory_order_seq_cst);
+        ReaderSlots::for_each([key] (ReaderSlot &slot) {
+            for (unsigned k = 0; slot.keys[0].load(std::memory_order_seq_cst) == key
+                              || slot.keys[1].load(std::memory_order_seq_cst) == key; k++) {
+                RWSpinLock::yield(k);
+            }
+        });
+    }
+
+    inline void end_write(std::atomic<uint64_t> &version) {
+        version.fetch_add(1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+
+namespace container {
+    /// A fixed table of cache-line padded slots, each owned by one thread for as long as it lives
+    ///
+    /// A thread writes only its own slot, others scan the prefix of the table that was ever handed
+    /// out. Threads that find the table full get nullptr and have to take a slower path.
+    template<typename Slot, uint32_t N>
+    struct ThreadSlots {
+        struct alignas(64) Padded : Slot {
+            std::atomic<bool> taken {false};
+        };
+
+        inline static Padded slots[N];
+        inline static std::atomic<uint32_t> used {0};     // no slot at or above this was ever taken
+
+        static Slot* mine() {
+            thread_local Owner owner;
+            return owner.slot;
+        }
+
+        template<typename F>
+        static void for_each(F &&callback) {
+            uint32_t num = used.load(std::memory_order_seq_cst);
+            for (uint32_t i = 0; i < num; i++) callback(static_cast<Slot&>(slots[i]));
+        }
+
+    private:
+        // hands the slot back when the thread exits
+        struct Owner {
+            Padded* slot = nullptr;
+
+            Owner() {
+                for (uint32_t i = 0; i < N; i++) {
+                    bool expected = false;
+                    if (slots[i].taken.compare_exchange_strong(expected, true)) {
+                        slot = &slots[i];
+                        uint32_t num = used.load();
+                        while (num < i + 1 && !used.compare_exchange_weak(num, i + 1)) {}
+                        return;
+                    }
+                }
+            }
+
+            ~Owner() {
+                if (slot) slot->taken.store(false, std::memory_order_release);
+            }
+        };
+    };
+}
@@ -7,36 +7,207 @@
 #include <stdexcept>
 #include <vector>
 #include <forward_list>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <new>
 #include <immintrin.h>
 #include "../rwlock.hpp"
 
 namespace container {
+    // a version whose timestamp carries this bit is a deletion marker (tombstone)
+    constexpr uint64_t TOMBSTONE_BIT = 1ull << 63;
+
+    inline uint64_t version_timestamp(uint64_t version) {
+        return version & ~TOMBSTONE_BIT;
+    }
+
+    inline bool is_tombstone(uint64_t version) {
+        return version & TOMBSTONE_BIT;
+    }
+
 #ifdef ENABLE_TIMESTAMP
+    struct VersionNode {
+        uint64_t timestamp;
+        VersionNode* next;
+    };
+
+    /// Slab allocator for the overflow versions of VersionEdgeEntry. Nodes are carved out of 64KB
+    /// chunks that keep their own free list, and a chunk goes back to the system once all of its
+    /// nodes are free again. Any thread may free any node, so an entry can be moved between blocks
+    /// (split, rebalance, gc) without caring where its versions were allocated. Freed nodes go to
+    /// the free list of the freeing thread, which hands them back to their chunks in batches once it
+    /// holds more than it is likely to reuse, or when the thread exits; a thread that runs dry takes
+    /// a batch from the chunks. That way the nodes the gc workers free end up with the writers.
+    class VersionArena {
+        static constexpr size_t CHUNK_SIZE = 1 << 16;
+        static constexpr size_t BATCH_SIZE = 256;
+
+        // the first cache line of every chunk, its nodes follow
+        struct alignas(64) Chunk {
+            VersionNode* free_list;
+            size_t live;            // nodes handed out
+            Chunk* prev;            // neighbours in the list of chunks with free nodes
+            Chunk* next;
+        };
+
+        static constexpr size_t CHUNK_NODES = (CHUNK_SIZE - sizeof(Chunk)) / sizeof(VersionNode);
+
+        // the chunks of all threads
+        struct Pool {
+            std::mutex mutex;
+            Chunk* partial = nullptr;       // chunks with a free node
+
+            // a null-terminated list of count nodes
+            VersionNode* take(size_t count) {
+                std::lock_guard<std::mutex> guard(mutex);
+                VersionNode* list = nullptr;
+                for (size_t i = 0; i < count; i++) {
+                    if (partial == nullptr) link(new_chunk());
+                    auto chunk = partial;
+                    auto node = chunk->free_list;
+                    chunk->free_list = node->next;
+                    chunk->live++;
+                    if (chunk->free_list == nullptr) unlink(chunk);
+                    node->next = list;
+                    list = node;
+                }
+                return list;
+            }
+
+            void give(VersionNode* list) {
+                std::lock_guard<std::mutex> guard(mutex);
+                while (list != nullptr) {
+                    auto node = list;
+                    list = list->next;
+                    auto chunk = reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(node) & ~(CHUNK_SIZE - 1));
+                    if (chunk->free_list == nullptr) link(chunk);
+                    node->next = chunk->free_list;
+                    chunk->free_list = node;
+                    // an empty chunk is kept only while no other one has a free node
+                    if (--chunk->live == 0 && (partial != chunk || chunk->next != nullptr)) {
+                        unlink(chunk);
+                        ::operator delete(chunk, std::align_val_t(CHUNK_SIZE));
+                    }
+                }
+            }
+
+        private:
+            Chunk* new_chunk() {
+                auto chunk = new (::operator new(CHUNK_SIZE, std::align_val_t(CHUNK_SIZE))) Chunk{nullptr, 0, nullptr, nullptr};
+                auto nodes = reinterpret_cast<VersionNode*>(chunk + 1);
+                for (size_t i = CHUNK_NODES; i-- > 0; ) {
+                    nodes[i].next = chunk->free_list;
+                    chunk->free_list = &nodes[i];
+                }
+                return chunk;
+            }
+
+            void link(Chunk* chunk) {
+                chunk->prev = nullptr;
+                chunk->next = partial;
+                if (partial) partial->prev = chunk;
+                partial = chunk;
+            }
+
+            void unlink(Chunk* chunk) {
+                if (chunk->prev) chunk->prev->next = chunk->next;
+                else partial = chunk->next;
+                if (chunk->next) chunk->next->prev = chunk->prev;
+            }
+        };
+
+        // never freed, a thread may hand its nodes back while the process exits
+        static Pool& pool() {
+            static auto pool = new Pool();
+            return *pool;
+        }
+
+        VersionNode* free_list {nullptr};
+        size_t free_count {0};
+
+    public:
+        static VersionArena& local() {
+            static thread_local VersionArena arena;
+            return arena;
+        }
+
+        VersionArena() = default;
+        VersionArena(const VersionArena &) = delete;
+        VersionArena &operator=(const VersionArena &) = delete;
+
+        ~VersionArena() {
+            if (free_list != nullptr) pool().give(free_list);
+        }
+
+        VersionNode* allocate(uint64_t timestamp, VersionNode* next) {
+            if (free_list == nullptr) {
+                free_list = pool().take(BATCH_SIZE);
+                free_count = BATCH_SIZE;
+            }
+            auto node = free_list;
+            free_list = free_list->next;
+            free_count--;
+            node->timestamp = timestamp;
+            node->next = next;
+            return node;
+        }
+
+        void deallocate(VersionNode* node) {
+            while (node != nullptr) {
+                auto next = node->next;
+                node->next = free_list;
+                free_list = node;
+                free_count++;
+                node = next;
+            }
+            if (free_count >= 2 * BATCH_SIZE) {
+                // keep one batch, the rest goes back to the chunks
+                auto last = free_list;
+                for (size_t i = 1; i < BATCH_SIZE; i++) last = last->next;
+                pool().give(last->next);
+                last->next = nullptr;
+                free_count = BATCH_SIZE;
+            }
+        }
+    };
+
+    /// The newest version is kept inline, older versions are chained (newest first) in
+    /// arena nodes which are only allocated once an edge has more than one version.
     struct VersionEdgeEntry {
         uint64_t dest;
-        std::forward_list<uint64_t>* version_chain;
+        uint64_t timestamp;
+        VersionNode* older;
 
-        VersionEdgeEntry() : dest(std::numeric_limits<uint64_t>::max()), version_chain(nullptr) {}
+        VersionEdgeEntry() : dest(std::numeric_limits<uint64_t>::max()), timestamp(0), older(nullptr) {}
 
-        explicit VersionEdgeEntry(uint64_t dest) : dest(dest), version_chain(nullptr)  {}
+        explicit VersionEdgeEntry(uint64_t dest) : dest(dest), timestamp(0), older(nullptr) {}
 
-        VersionEdgeEntry(uint64_t dest, uint64_t timestamp) : dest(dest) {
-            version_chain = new std::forward_list<uint64_t>();
-            version_chain->push_front(timestamp);
-        }
+        VersionEdgeEntry(uint64_t dest, uint64_t timestamp) : dest(dest), timestamp(timestamp), older(nullptr) {}
 
         ~VersionEdgeEntry() {
-            if(version_chain) delete version_chain;
-            version_chain = nullptr;
+            clear_version();
         }
 
         // delete copy Ctor
         VersionEdgeEntry(const VersionEdgeEntry &) = delete;
         VersionEdgeEntry &operator=(const VersionEdgeEntry &) = delete;
 
-        // enable move Ctor
-        VersionEdgeEntry(VersionEdgeEntry &&) = default;
-        VersionEdgeEntry &operator=(VersionEdgeEntry &&) = default; 
+        // enable move Ctor, the overflow chain is owned by a single entry
+        VersionEdgeEntry(VersionEdgeEntry &&other) noexcept : dest(other.dest), timestamp(other.timestamp), older(other.older) {
+            other.older = nullptr;
+        }
+
+        VersionEdgeEntry &operator=(VersionEdgeEntry &&other) noexcept {
+            if (this != &other) {
+                clear_version();
+                dest = other.dest;
+                timestamp = other.timestamp;
+                older = other.older;
+                other.older = nullptr;
+            }
+            return *this;
+        }
 
         bool operator<(const VersionEdgeEntry &rhs) const {
             return dest < rhs.dest;
@@ -46,56 +217,63 @@ namespace container {
             return this->dest < cmp_dest;
         }
 
-        void update_version(uint64_t timestamp) {
-            if (!version_chain) version_chain = new std::forward_list<uint64_t>();
-            version_chain->push_front(timestamp);
+        void update_version(uint64_t ts) {
+            older = VersionArena::local().allocate(timestamp, older);
+            timestamp = ts;
+        }
+
+        void delete_version(uint64_t ts) {
+            update_version(ts | TOMBSTONE_BIT);
+        }
+
+        bool is_deleted() const {
+            return is_tombstone(timestamp);
         }
 
         void clear_version() {
-            if (version_chain) {
-                delete version_chain;
-                version_chain = nullptr;
+            if (older) {
+                VersionArena::local().deallocate(older);
+                older = nullptr;
             }
         }
 
-        inline bool check_version(uint64_t timestamp) {
-            auto it = version_chain->begin();
-
-            if (__builtin_expect(*it <= timestamp, 1)) return true;
+        inline bool check_version(uint64_t ts) const {
+            if (__builtin_expect(timestamp <= ts, 1)) return true;
+            if (version_timestamp(timestamp) <= ts) return false;
 
-            for (++it; it != version_chain->end(); ++it) {
-                if (*it <= timestamp) return true;
+            // the newest version not after ts decides visibility
+            for (auto node = older; node != nullptr; node = node->next) {
+                if (version_timestamp(node->timestamp) <= ts) return !is_tombstone(node->timestamp);
             }
-
             return false;
         }
-        
-        void get_versions(std::vector<uint64_t>* ret_ptr) {
-            std::copy(version_chain->begin(), version_chain->end(), std::back_inserter(*ret_ptr));
+
+        void get_versions(std::vector<uint64_t>* ret_ptr) const {
+            ret_ptr->push_back(timestamp);
+            for (auto node = older; node != nullptr; node = node->next) {
+                ret_ptr->push_back(node->timestamp);
+            }
         }
 
         uint64_t get_dest() const {
             return dest;
         }
 
+        // drop the versions no reader at or after timestamp can see; returns true
+        // if the entry is a tombstone visible to all of them and can be removed
+        bool gc(uint64_t ts) {
+            if (version_timestamp(timestamp) <= ts) {
+                clear_version();
+                return is_tombstone(timestamp);
+            }
 
-        void gc(uint64_t timestamp) {
-            if (!version_chain) return;
-
-            auto it = version_chain->begin();
-            auto prev = version_chain->before_begin();
-            uint64_t cnt = 0;
-
-            while (it != version_chain->end()) {
-                if (*it < timestamp && cnt) {
-                    version_chain->erase_after(prev);
-                    break;
-                } else {
-                    prev = it;
-                    ++it;
-                    cnt++;
-                }
+            auto node = older;
+            while (node != nullptr && version_timestamp(node->timestamp) > ts) node = node->next;
+            if (node != nullptr && node->next != nullptr) {
+                VersionArena::local().deallocate(node->next);
+                node->next = nullptr;
             }
+            return false;
         }
     };
 
@@ -127,6 +305,12 @@ namespace container {
 
         void update_version(uint64_t timestamp) {}
 
+        void delete_version(uint64_t timestamp) {}
+
+        bool is_deleted() const {
+            return false;
+        }
+
         void clear_version() {}
 
         bool check_version(uint64_t timestamp) {
@@ -141,7 +325,9 @@ namespace container {
             return dest;
         }
 
-        void gc(uint64_t timestamp) {}
+        bool gc(uint64_t timestamp) {
+            return false;
+        }
     };
 #endif
 
@@ -170,11 +356,18 @@ namespace container {
             e_timestamp = timestamp;
         }
 
+        void delete_version(uint64_t timestamp) {
+            e_timestamp = timestamp;
+        }
+
         uint64_t get_dest() const {
             return dest;
         }
 
-        void gc(uint64_t timestamp) {}
+        // an entry ended before the oldest active reader is invisible to everyone
+        bool gc(uint64_t timestamp) {
+            return e_timestamp <= timestamp;
+        }
 
     };
 #else
@@ -196,143 +389,21 @@ namespace container {
 
         void update_version(uint64_t timestamp) {}
 
-        uint64_t get_dest() const {
-            return dest;
-        }
-
-        void gc(uint64_t timestamp) {}
-    };
-#endif
-
-#ifdef ENABLE_TIMESTAMP
-    struct VersionedEdgeEntry {
-        uint64_t dest;
-        uint64_t timestamp;
-        std::unique_ptr<VersionedEdgeEntry> next;
-
-        VersionedEdgeEntry() : dest(std::numeric_limits<uint64_t>::max()), timestamp(0), next(nullptr) {}
-
-        explicit VersionedEdgeEntry(uint64_t dest) : dest(dest), timestamp(0), next(nullptr)  {}
-
-        VersionedEdgeEntry(uint64_t dest, uint64_t ts) : dest(dest), timestamp(ts), next(nullptr) {}
-
-        // delete copy Ctor
-        VersionedEdgeEntry(const VersionedEdgeEntry &) = delete;
-        VersionedEdgeEntry &operator=(const VersionedEdgeEntry &) = delete;
-
-        // enable move Ctor
-        VersionedEdgeEntry(VersionedEdgeEntry &&) = default;
-        VersionedEdgeEntry &operator=(VersionedEdgeEntry &&) = default;
-
-        bool operator<(const VersionedEdgeEntry &rhs) const {
-            return dest < rhs.dest;
-        }
-
-        bool operator<(uint64_t cmp_dest) const {
-            return this->dest < cmp_dest;
-        }
-
-
-        void update_version(uint64_t ts) {
-            auto newVersion = std::make_unique<VersionedEdgeEntry>(this->dest, this->timestamp);
-            newVersion->next = std::move(this->next);
-            this->timestamp = ts;
-            this->next = std::move(newVersion);
-        }
-
-        void clear_version() {
-            if (next) {
-                next->clear_version();  
-            }
-            next.reset();
-        }
-
-        inline bool check_version(uint64_t ts) {
-            if (__builtin_expect(this->timestamp <= ts, 1)) return true;
-
-            auto entry = this;
-            entry = entry->next.get();
-
-            while (entry != nullptr) {
-                if (__builtin_expect(entry->timestamp <= ts, 1)) return true;
-                entry = entry->next.get();
-            }
-            return false;
-        }
-        
-        void get_versions(std::vector<uint64_t>* ret_ptr) {
-            auto entry = this;
-
-            while (entry != nullptr) {
-                ret_ptr->push_back(entry->timestamp);
-                entry = entry->next.get();
-            }
-        }
+        void delete_version(uint64_t timestamp) {}
 
         uint64_t get_dest() const {
             return dest;
         }
 
-        void gc(uint64_t timestamp) {
-            VersionedEdgeEntry* current = this;
-            while (current && current->next != nullptr) {
-                if (current->next->timestamp < timestamp) {
-                    auto to_delete = std::move(current->next);
-                    current->next = std::move(to_delete->next);
-                } else {
-                    current = current->next.get();
-                }
-            }
-        }
-    };
-
-#else
-    struct VersionedEdgeEntry {
-        uint64_t dest;
-
-        VersionedEdgeEntry() : dest(std::numeric_limits<uint64_t>::max()) {}
-
-        explicit VersionedEdgeEntry(uint64_t dest) : dest(dest) {}
-
-        VersionedEdgeEntry(uint64_t dest, uint64_t timestamp) : dest(dest) {}
-
-        // delete copy Ctor
-        VersionedEdgeEntry(const VersionedEdgeEntry &) = delete;
-        VersionedEdgeEntry &operator=(const VersionedEdgeEntry &) = delete;
-
-        // enable move Ctor
-        VersionedEdgeEntry(VersionedEdgeEntry &&) = default;
-        VersionedEdgeEntry &operator=(VersionedEdgeEntry &&) = default;
-
-        bool operator<(const VersionedEdgeEntry &rhs) const {
-            return dest < rhs.dest;
-        }
-
-        bool operator<(uint64_t cmp_dest) const {
-            return this->dest < cmp_dest;
-        }
-
-        void update_version(uint64_t timestamp) {}
-
-        void clear_version() {}
-
-        bool check_version(uint64_t timestamp) {
-            return true;
-        }
-
-        void get_versions(std::vector<uint64_t>* ret_ptr) {
-            ret_ptr->push_back(0);
-        }
-
-        uint64_t get_dest() const {
-            return dest;
+        bool gc(uint64_t timestamp) {
+            return false;
         }
-
-        void gc(uint64_t timestamp) {}
     };
-
 #endif
 
+    // the entry the containers and edge drivers are built with
+    using VersionedEdgeEntry = VersionEdgeEntry;
+
     struct PAMEntry {
         using key_t = uint64_t;
         using val_t = std::vector<uint64_t>;
@@ -1,37 +1,83 @@
 #pragma once
 
 #include <cstdint>
+#include <algorithm>
 #include <memory>
 #include <limits>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <forward_list>
+#include <type_traits>
+#include <utility>
+#include <optional>
 #include <immintrin.h>
 #include "../rwlock.hpp"
+#include "../lock_table.hpp"
+#include "../optimistic.hpp"
+#include "../config.hpp"
+#include "../intersect.hpp"
 #include "edge_types.hpp"
+#ifdef ENABLE_ADAPTIVE
+#include <atomic>
+#include "edge_index/hashmap.hpp"
+#endif
 
 namespace container {
 
 template<template<typename> class EdgeIndex, typename EdgeEntry>
 struct NeighborEntry;
 
+// entries carrying their own version chain can be kept inline and replayed into an index later
+template<typename EdgeEntry, typename = void>
+struct is_inline_edge_entry : std::false_type {};
+
+template<typename EdgeEntry>
+struct is_inline_edge_entry<EdgeEntry, std::void_t<decltype(std::declval<EdgeEntry&>().is_deleted()),
+        decltype(std::declval<EdgeEntry&>().get_versions(std::declval<std::vector<uint64_t>*>()))>> : std::true_type {};
+
+template<typename EdgeEntry>
+constexpr bool InlineEdgeEntry = is_inline_edge_entry<EdgeEntry>::value;
+
+// indexes keeping a write delta that versioned writes cannot fold on their own
+template<typename Index, typename = void>
+struct has_fold_delta : std::false_type {};
+
+template<typename Index>
+struct has_fold_delta<Index, std::void_t<decltype(std::declval<Index&>().fold_delta(uint64_t{}, std::declval<uint64_t(*)(uint64_t)>()))>> : std::true_type {};
+
+template<template<typename> class EdgeIndex, typename EdgeEntry, bool Inline = InlineEdgeEntry<EdgeEntry> && (container::config::INLINE_EDGES > 0)>
+struct VertexNeighbors;
+
 #ifdef ENABLE_TIMESTAMP
+    struct DegreeVersion {
+        uint64_t degree;
+        uint64_t timestamp;
+    };
+
     template<template<typename> class EdgeIndex, typename EdgeEntry>
-    struct VertexEntry {
+    struct VertexEntry : VertexNeighbors<EdgeIndex, EdgeEntry> {
+        // newest degrees live in a ring inside the entry; versions pushed out of a full ring that an
+        // open snapshot may still read go to the overflow array (oldest first) until gc drops them
+        static constexpr uint32_t DEGREE_SLOTS = 4;
+
         uint64_t vertex{};
-        NeighborEntry<EdgeIndex, EdgeEntry>* neighbor;
-        std::forward_list<std::pair<uint64_t, uint64_t>>* degree;
+        DegreeVersion degree[DEGREE_SLOTS];
+        uint32_t degree_head = 0;       // slot of the newest degree
+        uint32_t degree_num = 0;        // valid slots, counted backwards from degree_head
+        std::unique_ptr<std::vector<DegreeVersion>> degree_overflow;
         // void *neighbor_ptr{};
 
-#ifdef ENABLE_LOCK
+#if defined(ENABLE_LOCK) && !defined(ENABLE_LOCK_STRIPING)
         std::unique_ptr<RWSpinLock> spinlock{};
+#ifdef ENABLE_OPTIMISTIC_READ
+        std::atomic<uint64_t> version{0};
+#endif
 #endif
 
         VertexEntry() : vertex(std::numeric_limits<uint64_t>::max())
         {
-                degree = new std::forward_list<std::pair<uint64_t, uint64_t>>();
-#ifdef ENABLE_LOCK
+#if defined(ENABLE_LOCK) && !defined(ENABLE_LOCK_STRIPING)
                 spinlock = std::make_unique<RWSpinLock>();
 #endif
         }
@@ -39,68 +85,109 @@ struct NeighborEntry;
         explicit VertexEntry(uint64_t vertex, uint64_t timestamp) 
             : vertex(vertex)
         {
-            degree = new std::forward_list<std::pair<uint64_t, uint64_t>>();
-            degree->push_front({0, timestamp});
-#ifdef ENABLE_LOCK
+            update_degree(0, timestamp);
+#if defined(ENABLE_LOCK) && !defined(ENABLE_LOCK_STRIPING)
                 spinlock = std::make_unique<RWSpinLock>();
 #endif
         }
 
         explicit VertexEntry(uint64_t vertex, uint64_t timestamp, NeighborEntry<EdgeIndex, EdgeEntry>* neighbor_ptr) 
-            : vertex(vertex), neighbor(neighbor_ptr)
+            : VertexNeighbors<EdgeIndex, EdgeEntry>(neighbor_ptr), vertex(vertex)
         {
-            degree = new std::forward_list<std::pair<uint64_t, uint64_t>>();
-            degree->push_front({0, timestamp});
-#ifdef ENABLE_LOCK
+            update_degree(0, timestamp);
+#if defined(ENABLE_LOCK) && !defined(ENABLE_LOCK_STRIPING)
                 spinlock = std::make_unique<RWSpinLock>();
 #endif
         }
 
         uint64_t get_degree(uint64_t timestamp) const {   
-            for (const auto& val : *degree) {
-                if (val.second <= timestamp) return val.first;
+            auto found = find_degree(timestamp);
+            if (!found) throw std::runtime_error("Invalid timestamp from container::VertexEntry::get_degree(uint64_t timestamp)\n");
+            return *found;
+        }
+
+        // nullopt if no degree was recorded at or before timestamp
+        std::optional<uint64_t> find_degree(uint64_t timestamp) const {
+            uint32_t slot = degree_head;
+            for (uint32_t i = 0; i < degree_num; i++) {
+                if (degree[slot].timestamp <= timestamp) return degree[slot].degree;
+                slot = slot == 0 ? DEGREE_SLOTS - 1 : slot - 1;
             }
-            throw std::runtime_error("Invalid timestamp from container::VertexEntry::get_degree(uint64_t timestamp)\n");
+            if (degree_overflow) {
+                for (auto it = degree_overflow->rbegin(); it != degree_overflow->rend(); ++it) {
+                    if (it->timestamp <= timestamp) return it->degree;
+                }
+            }
+            return std::nullopt;
         }
 
+        // keeps every degree a full ring pushes out
         void update_degree(uint64_t new_degree, uint64_t timestamp) {
-            if (!degree) degree = new std::forward_list<std::pair<uint64_t, uint64_t>>();
-            degree->push_front({new_degree, timestamp});
+            update_degree(new_degree, timestamp, [] (uint64_t) -> uint64_t { return 0; });
         }
 
-        void gc(uint64_t timestamp) {
-            if (!degree) return;
+        /// oldest_snapshot(needed) returns a timestamp no open snapshot is older than, it is only
+        /// asked once the ring is full and may stop looking as soon as it has found one >= needed
+        template<typename F>
+        void update_degree(uint64_t new_degree, uint64_t timestamp, F &&oldest_snapshot) {
+            // an older degree with the same timestamp can never be read, overwrite it
+            if (degree_num > 0 && degree[degree_head].timestamp == timestamp) {
+                degree[degree_head].degree = new_degree;
+                return;
+            }
+
+            if (degree_num > 0) degree_head = degree_head + 1 == DEGREE_SLOTS ? 0 : degree_head + 1;
+            if (degree_num == DEGREE_SLOTS) {
+                // the pushed out degree is read only by snapshots older than the one after it
+                uint64_t successor = degree[degree_head + 1 == DEGREE_SLOTS ? 0 : degree_head + 1].timestamp;
+                if (oldest_snapshot(successor) >= successor) {
+                    // neither it nor anything that overflowed before is visible anymore
+                    clear_overflow();
+                } else {
+                    if (!degree_overflow) degree_overflow = std::make_unique<std::vector<DegreeVersion>>();
+                    degree_overflow->push_back(degree[degree_head]);
+                }
+            } else {
+                degree_num++;
+            }
+            degree[degree_head] = {new_degree, timestamp};
+        }
 
-            auto it = degree->begin();
-            auto prev = degree->before_begin();
-            uint64_t cnt = 0;
+        // keep the newest degree visible at timestamp and everything after it
+        void gc(uint64_t timestamp) {
+            uint32_t slot = degree_head;
+            for (uint32_t i = 0; i < degree_num; i++) {
+                if (degree[slot].timestamp <= timestamp) {
+                    degree_num = i + 1;
+                    clear_overflow();
+                    return;
+                }
+                slot = slot == 0 ? DEGREE_SLOTS - 1 : slot - 1;
+            }
+            if (!degree_overflow) return;
 
-            while (it != degree->end()) {
-                if (it->second < timestamp && cnt) {
-                    degree->erase_after(prev);
+            auto it = degree_overflow->end();
+            while (it != degree_overflow->begin()) {
+                --it;
+                if (it->timestamp <= timestamp) {
+                    degree_overflow->erase(degree_overflow->begin(), it);
                     break;
-                } else {
-                    prev = it;
-                    ++it;
-                    cnt++;
                 }
             }
         }
 
+        void clear_overflow() {
+            degree_overflow.reset();
+        }
+
         void clear_degree() {
-            if(degree) {
-                delete degree;
-                degree = nullptr;
-            }
+            clear_overflow();
+            degree_num = 0;
         }
 
         void clear() {
             clear_degree();
-            if (neighbor) {
-                neighbor->clear();
-                delete neighbor;
-                neighbor = nullptr;
-            }
+            this->clear_neighbors();
         }
 
         bool operator==(const VertexEntry &other) const {
@@ -113,25 +200,46 @@ struct NeighborEntry;
 
 #ifdef ENABLE_LOCK
         void lock() {
-            spinlock->lock();
+            get_lock()->lock();
+#ifdef ENABLE_OPTIMISTIC_READ
+            optimistic::begin_write(get_version(), lock_table::order_of(vertex));
+#endif
         }
 
         void unlock() {
-            spinlock->unlock();
+#ifdef ENABLE_OPTIMISTIC_READ
+            optimistic::end_write(get_version());
+#endif
+            get_lock()->unlock();
         }
 
         void lock_shared() {
-            spinlock->lock_shared();
+            get_lock()->lock_shared();
         }
 
         void unlock_shared() {
-            spinlock->unlock_shared();
+            get_lock()->unlock_shared();
         }
 
         RWSpinLock* get_lock() {
+#ifdef ENABLE_LOCK_STRIPING
+            return &lock_table::get(vertex);
+#else
             return spinlock.get();
+#endif
         }
 
+#ifdef ENABLE_OPTIMISTIC_READ
+        // odd while a writer holds the lock
+        std::atomic<uint64_t>& get_version() {
+#ifdef ENABLE_LOCK_STRIPING
+            return lock_table::stripe(vertex).version;
+#else
+            return version;
+#endif
+        }
+#endif
+
 #else
         void lock() {}
 
@@ -144,27 +252,29 @@ struct NeighborEntry;
     };
 #else
     template<template<typename> class EdgeIndex, typename EdgeEntry>
-    struct VertexEntry {
+    struct VertexEntry : VertexNeighbors<EdgeIndex, EdgeEntry> {
         uint64_t vertex{};
         uint64_t degree;
         // void *neighbor_ptr{};
-        NeighborEntry<EdgeIndex, EdgeEntry>* neighbor;
 
-#ifdef ENABLE_LOCK
+#if defined(ENABLE_LOCK) && !defined(ENABLE_LOCK_STRIPING)
         std::unique_ptr<RWSpinLock> spinlock{};
+#ifdef ENABLE_OPTIMISTIC_READ
+        std::atomic<uint64_t> version{0};
+#endif
 #endif
 
         VertexEntry() : vertex(std::numeric_limits<uint64_t>::max()), degree(0)
         {
-#ifdef ENABLE_LOCK
+#if defined(ENABLE_LOCK) && !defined(ENABLE_LOCK_STRIPING)
                 spinlock = std::make_unique<RWSpinLock>();
 #endif
         }
 
         explicit VertexEntry(uint64_t vertex, uint64_t timestamp, NeighborEntry<EdgeIndex, EdgeEntry>* neighbor_ptr) 
-            : vertex(vertex), degree(0), neighbor(neighbor_ptr)
+            : VertexNeighbors<EdgeIndex, EdgeEntry>(neighbor_ptr), vertex(vertex), degree(0)
         {
-#ifdef ENABLE_LOCK
+#if defined(ENABLE_LOCK) && !defined(ENABLE_LOCK_STRIPING)
                 spinlock = std::make_unique<RWSpinLock>();
 #endif
         }
@@ -172,6 +282,10 @@ struct NeighborEntry;
         uint64_t get_degree(uint64_t timestamp) const {   
             return degree;
         }
+
+        std::optional<uint64_t> find_degree(uint64_t timestamp) const {
+            return degree;
+        }
         
         void gc(uint64_t timestamp) {
 
@@ -181,14 +295,16 @@ struct NeighborEntry;
             degree = new_degree;
         }
 
+        // a single degree, there is no history to bound
+        template<typename F>
+        void update_degree(uint64_t new_degree, uint64_t timestamp, F &&) {
+            degree = new_degree;
+        }
+
         void clear_degree() {}
 
         void clear() {
-            if (neighbor) {
-                neighbor->clear();
-                delete neighbor;
-                neighbor = nullptr;
-            }
+            this->clear_neighbors();
         }
 
         bool operator==(const VertexEntry &other) const {
@@ -201,20 +317,45 @@ struct NeighborEntry;
 
 #ifdef ENABLE_LOCK
         void lock() {
-            spinlock->lock();
+            get_lock()->lock();
+#ifdef ENABLE_OPTIMISTIC_READ
+            optimistic::begin_write(get_version(), lock_table::order_of(vertex));
+#endif
         }
 
         void unlock() {
-            spinlock->unlock();
+#ifdef ENABLE_OPTIMISTIC_READ
+            optimistic::end_write(get_version());
+#endif
+            get_lock()->unlock();
         }
 
         void lock_shared() {
-            spinlock->lock_shared();
+            get_lock()->lock_shared();
         }
 
         void unlock_shared() {
-            spinlock->unlock_shared();
+            get_lock()->unlock_shared();
         }
+
+        RWSpinLock* get_lock() {
+#ifdef ENABLE_LOCK_STRIPING
+            return &lock_table::get(vertex);
+#else
+            return spinlock.get();
+#endif
+        }
+
+#ifdef ENABLE_OPTIMISTIC_READ
+        // odd while a writer holds the lock
+        std::atomic<uint64_t>& get_version() {
+#ifdef ENABLE_LOCK_STRIPING
+            return lock_table::stripe(vertex).version;
+#else
+            return version;
+#endif
+        }
+#endif
 #else
         void lock() {}
 
@@ -262,6 +403,7 @@ struct NeighborEntry;
     enum NeighborType {
         Vector,
         NonVector,
+        Hash,
     };
 
     template <typename EdgeEntry>
@@ -300,14 +442,16 @@ struct NeighborEntry;
 
     template<typename EdgeEntry>
     class VectorIteratorImpl {
-        using VecIterator = typename std::vector<EdgeEntry>::iterator;
+        using VecIterator = EdgeEntry*;
         VecIterator iterator;
         VecIterator end;
         uint64_t timestamp;
 
     public:
         VectorIteratorImpl(VecIterator begin, VecIterator end, uint64_t ts)
-            : iterator(begin), end(end), timestamp(ts) {}
+            : iterator(begin), end(end), timestamp(ts) {
+            while (valid() && !iterator->check_version(timestamp)) ++iterator;
+        }
 
         VectorIteratorImpl(const VectorIteratorImpl &other)
             : iterator(other.iterator), end(other.end), timestamp(other.timestamp) {}
@@ -385,15 +529,29 @@ struct NeighborEntry;
 
 
 #ifdef ENABLE_ADAPTIVE
+    /// Neighborhoods start as a sorted vector and move to the EdgeIndex once they outgrow
+    /// config::DEFAULT_VECTOR_SIZE. Hubs of at least config::HASH_NEIGHBOR_SIZE edges which have seen
+    /// config::HASH_READ_RATIO lookups per write move on to a hash index. The thresholds are read at
+    /// runtime, so one binary serves sparse and skewed graphs.
     template<template<typename> class EdgeIndex, typename EdgeEntry>
     struct NeighborEntry {
         NeighborType type;
         std::vector<EdgeEntry>* vector_ptr;
         EdgeIndex<EdgeEntry>* neighbor_ptr;
+        HashmapEdgeIndex<EdgeEntry>* hash_ptr;
+#ifdef ENABLE_WEIGHT
+        std::vector<double> vector_weights;     // parallel to *vector_ptr
+#endif
 
-        NeighborEntry(): type(Vector) {
+        // live edges and the observed mix, only used to pick the tier
+        uint64_t m_size;
+        uint64_t m_writes;
+        mutable std::atomic<uint64_t> m_lookups;
+
+        NeighborEntry(): type(Vector), m_size(0), m_writes(0), m_lookups(0) {
             vector_ptr = new std::vector<EdgeEntry>{};
             neighbor_ptr = nullptr;
+            hash_ptr = nullptr;
         }
 
         NeighborEntry(NeighborEntry &other) = delete;
@@ -402,47 +560,121 @@ struct NeighborEntry;
             clear();
         }
 
-        bool insert_edge(uint64_t dest, uint64_t timestamp) {
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0) {
+            bool inserted;
             if (type == Vector) {
-                if (vector_ptr->size() < container::config::DEFAULT_VECTOR_SIZE) {
-                    auto pos = std::lower_bound(vector_ptr->begin(), vector_ptr->end(), dest, [] (const EdgeEntry &entry, uint64_t dest) {
-                        return entry.get_dest() < dest;
-                    });
-                    if (pos != vector_ptr->end() && pos->get_dest() == dest) {
-                        pos->update_version(timestamp);
-                        return false;
-                    } else {
-                        EdgeEntry entry{dest, timestamp};
-                        vector_ptr->insert(pos, std::move(entry));
-                        return true;
-                    }
+                if (vector_ptr->size() >= container::config::DEFAULT_VECTOR_SIZE) {
+                    // the retry counts the write
+                    migrate_to_index();
+                    return insert_edge(dest, timestamp, weight);
+                }
+                auto pos = std::lower_bound(vector_ptr->begin(), vector_ptr->end(), dest, [] (const EdgeEntry &entry, uint64_t dest) {
+                    return entry.get_dest() < dest;
+                });
+                bool found = pos != vector_ptr->end() && pos->get_dest() == dest;
+#ifdef ENABLE_WEIGHT
+                auto weight_pos = vector_weights.begin() + (pos - vector_ptr->begin());
+                if (found) *weight_pos = weight;
+                else vector_weights.insert(weight_pos, weight);
+#endif
+                if (found) {
+                    inserted = pos->is_deleted();
+                    pos->update_version(timestamp);
                 } else {
-                    neighbor_ptr = new EdgeIndex<EdgeEntry>();
-                    for (auto & entry : *vector_ptr) {
-                        std::vector<uint64_t> versions;
-                        entry.get_versions(&versions);
-                        for (int i = versions.size() - 1; i >= 0; i--) {
-                            neighbor_ptr->insert_edge(entry.get_dest(), versions[i]);
-                        }
-                    }
-                    delete vector_ptr;
-                    vector_ptr = nullptr;
-                    type = NonVector;
-                    return neighbor_ptr->insert_edge(dest, timestamp);
+                    EdgeEntry entry{dest, timestamp};
+                    vector_ptr->insert(pos, std::move(entry));
+                    inserted = true;
                 }
+            } else if (type == NonVector) {
+                inserted = neighbor_ptr->insert_edge(dest, timestamp, weight);
             } else {
-                return neighbor_ptr->insert_edge(dest, timestamp);
+                inserted = hash_ptr->insert_edge(dest, timestamp, weight);
             }
+            m_writes++;
+            m_size += inserted;
+            if (type == NonVector) adapt();
+            return inserted;
         }
 
-        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp) {
+        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {}) {
             uint64_t sum = 0;
-            for (auto & dest : dest_list) {
-                sum += this->insert_edge(dest, timestamp);
+            if (type == Vector) {
+                for (size_t i = 0; i < dest_list.size(); i++) {
+                    sum += this->insert_edge(dest_list[i], timestamp, weight_list.empty() ? 0.0 : weight_list[i]);
+                }
+                return sum;
             }
+
+            m_writes += dest_list.size();
+            if (type == NonVector) sum = neighbor_ptr->insert_edge_batch(dest_list, timestamp, weight_list);
+            else sum = hash_ptr->insert_edge_batch(dest_list, timestamp, weight_list);
+            m_size += sum;
+            if (type == NonVector) adapt();
             return sum;
         }
 
+        bool remove_edge(uint64_t dest, uint64_t timestamp) {
+            m_writes++;
+            bool removed;
+            if (type == Vector) {
+                auto pos = std::lower_bound(vector_ptr->begin(), vector_ptr->end(), dest, [] (const EdgeEntry &entry, uint64_t dest) {
+                    return entry.get_dest() < dest;
+                });
+                if (pos == vector_ptr->end() || pos->get_dest() != dest || pos->is_deleted()) return false;
+#ifdef ENABLE_TIMESTAMP
+                pos->delete_version(timestamp);
+#else
+#ifdef ENABLE_WEIGHT
+                vector_weights.erase(vector_weights.begin() + (pos - vector_ptr->begin()));
+#endif
+                vector_ptr->erase(pos);
+#endif
+                removed = true;
+            } else if (type == NonVector) {
+                removed = neighbor_ptr->remove_edge(dest, timestamp);
+            } else {
+                removed = hash_ptr->remove_edge(dest, timestamp);
+            }
+            m_size -= removed;
+            return removed;
+        }
+
+        uint64_t gc(uint64_t timestamp) {
+            if (type == Vector) {
+                auto size = vector_ptr->size();
+#ifdef ENABLE_WEIGHT
+                uint64_t keep = 0;
+                for (uint64_t i = 0; i < size; i++) {
+                    if ((*vector_ptr)[i].gc(timestamp)) continue;
+                    if (keep != i) {
+                        (*vector_ptr)[keep] = std::move((*vector_ptr)[i]);
+                        vector_weights[keep] = vector_weights[i];
+                    }
+                    keep++;
+                }
+                vector_ptr->erase(vector_ptr->begin() + keep, vector_ptr->end());
+                vector_weights.resize(keep);
+#else
+                vector_ptr->erase(std::remove_if(vector_ptr->begin(), vector_ptr->end(), [timestamp] (EdgeEntry &entry) {
+                    return entry.gc(timestamp);
+                }), vector_ptr->end());
+#endif
+                return size - vector_ptr->size();
+            } else if (type == NonVector) {
+                return neighbor_ptr->gc(timestamp);
+            } else {
+                return hash_ptr->gc(timestamp);
+            }
+        }
+
+        // lets an index that keeps a write delta fold it, oldest_snapshot as in VertexEntry::update_degree
+        template<typename F>
+        void fold_delta(uint64_t timestamp, F &&oldest_snapshot) {
+            if constexpr (has_fold_delta<EdgeIndex<EdgeEntry>>::value) {
+                if (type == NonVector) neighbor_ptr->fold_delta(timestamp, oldest_snapshot);
+            }
+        }
+
         bool has_edge(uint64_t src, uint64_t dest, uint64_t timestamp) const {
             if (type == Vector) {
                 auto pos = std::lower_bound(vector_ptr->begin(), vector_ptr->end(), dest, [] (const EdgeEntry &entry, uint64_t dest) {
@@ -452,33 +684,61 @@ struct NeighborEntry;
                     return pos->check_version(timestamp);
                 }
                 return false;
-            } else return neighbor_ptr->has_edge(src, dest, timestamp);
+            }
+            count_lookup();
+            if (type == NonVector) return neighbor_ptr->has_edge(src, dest, timestamp);
+            return hash_ptr->has_edge(src, dest, timestamp);
+        }
+
+        double get_weight(uint64_t dest, uint64_t timestamp) const {
+            if (type == Vector) {
+                auto pos = std::lower_bound(vector_ptr->begin(), vector_ptr->end(), dest, [] (const EdgeEntry &entry, uint64_t dest) {
+                    return entry.get_dest() < dest;
+                });
+                if (pos == vector_ptr->end() || pos->get_dest() != dest || !pos->check_version(timestamp)) return std::numeric_limits<double>::quiet_NaN();
+                return vector_weight(pos - vector_ptr->begin());
+            }
+            count_lookup();
+            if (type == NonVector) return neighbor_ptr->get_weight(dest, timestamp);
+            return hash_ptr->get_weight(dest, timestamp);
         }
 
         template<typename F>
         uint64_t edges(F&& callback, uint64_t timestamp) const {
             if (type == Vector) {
                 uint64_t sum = 0;
-                for (auto &entry : *vector_ptr) {
+                for (uint64_t i = 0; i < vector_ptr->size(); i++) {
+                    auto &entry = (*vector_ptr)[i];
                     if (entry.check_version(timestamp)) {
-                        bool should_continue = callback(entry.get_dest(), 0.0); // NOTE: Do not support weight now
+                        bool should_continue = callback(entry.get_dest(), vector_weight(i));
                         sum += entry.dest;
                         if (!should_continue) return sum;
                     }
                 }
                 return sum;
-            } else return neighbor_ptr->edges(callback, timestamp);
+            } else if (type == NonVector) {
+                return neighbor_ptr->edges(callback, timestamp);
+            } else {
+                return hash_ptr->edges(callback, timestamp);
+            }
         }
         
         uint64_t intersect(const NeighborEntry<EdgeIndex, EdgeEntry> & other, uint64_t timestamp) {
-            return 0;
+            if (type == NonVector && other.type == NonVector) return neighbor_ptr->intersect(*other.neighbor_ptr, timestamp);
+            if (type == Hash && other.type == Hash) return hash_ptr->intersect(*other.hash_ptr, timestamp);
+            return intersect::neighbors(*this, other, timestamp);
         }
 
         void clear() {
             if (type == Vector && vector_ptr != nullptr) delete vector_ptr;
             else if (type == NonVector && neighbor_ptr != nullptr) delete neighbor_ptr;
+            else if (type == Hash && hash_ptr != nullptr) {
+                hash_ptr->clear();
+                delete hash_ptr;
+            }
             vector_ptr = nullptr;
             neighbor_ptr = nullptr;
+            hash_ptr = nullptr;
         }
 
         EdgeIndex<EdgeEntry>* get_neighbor_ptr() {
@@ -487,20 +747,83 @@ struct NeighborEntry;
 #ifdef ENABLE_LOCK
         UnifiedIterator<EdgeEntry> get_begin(uint64_t timestamp, RWSpinLock *lock, bool read_only = true) const {
             if (type == Vector) {
-                return UnifiedIterator<EdgeEntry>(VectorIteratorImpl<EdgeEntry>{vector_ptr->begin(), vector_ptr->end(), timestamp}, lock, read_only);
-            } else {
+                return UnifiedIterator<EdgeEntry>(VectorIteratorImpl<EdgeEntry>{vector_ptr->data(), vector_ptr->data() + vector_ptr->size(), timestamp}, lock, read_only);
+            } else if (type == NonVector) {
                 return UnifiedIterator<EdgeEntry>(neighbor_ptr->get_begin(timestamp), lock, read_only);
+            } else {
+                return UnifiedIterator<EdgeEntry>(hash_ptr->get_begin(timestamp), lock, read_only);
             }
         }
 #else
         UnifiedIterator<EdgeEntry> get_begin(uint64_t timestamp) const {
             if (type == Vector) {
-                return UnifiedIterator<EdgeEntry>(VectorIteratorImpl<EdgeEntry>{vector_ptr->begin(), vector_ptr->end(), timestamp});
-            } else {
+                return UnifiedIterator<EdgeEntry>(VectorIteratorImpl<EdgeEntry>{vector_ptr->data(), vector_ptr->data() + vector_ptr->size(), timestamp});
+            } else if (type == NonVector) {
                 return UnifiedIterator<EdgeEntry>(neighbor_ptr->get_begin(timestamp));
+            } else {
+                return UnifiedIterator<EdgeEntry>(hash_ptr->get_begin(timestamp));
             }
         }
 #endif
+
+    private:
+        double vector_weight(uint64_t idx) const {
+#ifdef ENABLE_WEIGHT
+            return vector_weights[idx];
+#else
+            return 0.0;
+#endif
+        }
+
+        // replays the versions of every entry oldest first, so readers keep seeing the same history
+        void migrate_to_index() {
+            neighbor_ptr = new EdgeIndex<EdgeEntry>();
+            std::vector<uint64_t> versions;
+            for (uint64_t idx = 0; idx < vector_ptr->size(); idx++) {
+                auto &entry = (*vector_ptr)[idx];
+                versions.clear();
+                entry.get_versions(&versions);
+                for (int i = versions.size() - 1; i >= 0; i--) {
+                    if (is_tombstone(versions[i])) neighbor_ptr->remove_edge(entry.get_dest(), version_timestamp(versions[i]));
+                    else neighbor_ptr->insert_edge(entry.get_dest(), versions[i], vector_weight(idx));
+                }
+            }
+            delete vector_ptr;
+            vector_ptr = nullptr;
+#ifdef ENABLE_WEIGHT
+            std::vector<double>().swap(vector_weights);
+#endif
+            type = NonVector;
+        }
+
+        // only the index tier can still switch, and only if the hash tier is enabled at all; this keeps
+        // concurrent readers of a hub off a shared counter in the default build
+        void count_lookup() const {
+            if (type == NonVector && container::config::HASH_NEIGHBOR_SIZE != 0) {
+                m_lookups.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // hubs that are mostly probed trade ordered scans for single probe lookups
+        void adapt() {
+            auto threshold = container::config::HASH_NEIGHBOR_SIZE;
+            if (threshold == 0 || m_size < threshold) return;
+            if (m_lookups.load(std::memory_order_relaxed) < container::config::HASH_READ_RATIO * m_writes) return;
+
+            // entries are moved with their version chains, nothing has to be replayed
+            hash_ptr = new HashmapEdgeIndex<EdgeEntry>();
+            hash_ptr->m_map->reserve(m_size);
+            neighbor_ptr->for_each_entry([this] (EdgeEntry &entry, double weight) {
+                auto dest = entry.get_dest();
+                hash_ptr->m_map->try_emplace(dest, std::move(entry));
+#ifdef ENABLE_WEIGHT
+                hash_ptr->m_weights->push_back(weight);
+#endif
+            });
+            delete neighbor_ptr;
+            neighbor_ptr = nullptr;
+            type = Hash;
+        }
     };
 #else
     template<template<typename> class EdgeIndex, typename EdgeEntry>
@@ -517,25 +840,45 @@ struct NeighborEntry;
             if (neighbor_ptr != nullptr) delete neighbor_ptr;
         }
 
-        bool insert_edge(uint64_t dest, uint64_t timestamp) {
-            return neighbor_ptr->insert_edge(dest, timestamp);
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0) {
+            return neighbor_ptr->insert_edge(dest, timestamp, weight);
+        }
+
+        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {}) {
+            return neighbor_ptr->insert_edge_batch(dest_list, timestamp, weight_list);
         }
 
-        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp) {
-            return neighbor_ptr->insert_edge_batch(dest_list, timestamp);
+        bool remove_edge(uint64_t dest, uint64_t timestamp) {
+            return neighbor_ptr->remove_edge(dest, timestamp);
+        }
+
+        uint64_t gc(uint64_t timestamp) {
+            return neighbor_ptr->gc(timestamp);
+        }
+
+        // lets an index that keeps a write delta fold it, oldest_snapshot as in VertexEntry::update_degree
+        template<typename F>
+        void fold_delta(uint64_t timestamp, F &&oldest_snapshot) {
+            if constexpr (has_fold_delta<EdgeIndex<EdgeEntry>>::value) {
+                neighbor_ptr->fold_delta(timestamp, oldest_snapshot);
+            }
         }
 
         bool has_edge(uint64_t src, uint64_t dest, uint64_t timestamp) const {
             return neighbor_ptr->has_edge(src, dest, timestamp);
         }
 
+        double get_weight(uint64_t dest, uint64_t timestamp) const {
+            return neighbor_ptr->get_weight(dest, timestamp);
+        }
+
         template<typename F>
         uint64_t edges(F&& callback, uint64_t timestamp) const {
             return neighbor_ptr->edges(callback, timestamp);
         }
         
         uint64_t intersect(const NeighborEntry<EdgeIndex, EdgeEntry> & other, uint64_t timestamp) {
-            return 0;
+            return neighbor_ptr->intersect(*other.neighbor_ptr, timestamp);
         }
 
         void clear() {
@@ -558,4 +901,264 @@ struct NeighborEntry;
 #endif
     };
 #endif
-}
\ No newline at end of file
+
+    /// The edges of a vertex. Up to config::INLINE_EDGES of them are kept sorted inside the vertex
+    /// entry, the NeighborEntry is only allocated once they overflow and then holds every edge.
+    template<template<typename> class EdgeIndex, typename EdgeEntry, bool Inline>
+    struct VertexNeighbors {
+        static constexpr uint32_t INLINE_CAPACITY = container::config::INLINE_EDGES;
+        static_assert(INLINE_CAPACITY * sizeof(EdgeEntry) <= 128, "inline edges must fit in two cache lines");
+
+        NeighborEntry<EdgeIndex, EdgeEntry>* neighbor {nullptr};
+        mutable EdgeEntry inline_edges[INLINE_CAPACITY];
+#ifdef ENABLE_WEIGHT
+        double inline_weights[INLINE_CAPACITY];
+#endif
+        uint32_t inline_num {0};
+
+        VertexNeighbors() = default;
+
+        explicit VertexNeighbors(NeighborEntry<EdgeIndex, EdgeEntry>* neighbor_ptr) : neighbor(neighbor_ptr) {}
+
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0) {
+            if (neighbor) return neighbor->insert_edge(dest, timestamp, weight);
+
+            auto end = inline_edges + inline_num;
+            auto pos = inline_find(dest);
+            if (pos != end && pos->get_dest() == dest) {
+                bool revived = pos->is_deleted();
+                pos->update_version(timestamp);
+#ifdef ENABLE_WEIGHT
+                inline_weights[pos - inline_edges] = weight;
+#endif
+                return revived;
+            }
+            if (inline_num == container::config::INLINE_EDGES) {
+                spill();
+                return neighbor->insert_edge(dest, timestamp, weight);
+            }
+            std::move_backward(pos, end, end + 1);
+            *pos = EdgeEntry{dest, timestamp};
+#ifdef ENABLE_WEIGHT
+            auto weight_pos = inline_weights + (pos - inline_edges);
+            std::copy_backward(weight_pos, inline_weights + inline_num, inline_weights + inline_num + 1);
+            *weight_pos = weight;
+#endif
+            inline_num++;
+            return true;
+        }
+
+        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {}) {
+            if (!neighbor && dest_list.size() > container::config::INLINE_EDGES - inline_num) spill();
+            if (neighbor) return neighbor->insert_edge_batch(dest_list, timestamp, weight_list);
+
+            uint64_t sum = 0;
+            for (size_t i = 0; i < dest_list.size(); i++) sum += insert_edge(dest_list[i], timestamp, weight_list.empty() ? 0.0 : weight_list[i]);
+            return sum;
+        }
+
+        bool remove_edge(uint64_t dest, uint64_t timestamp) {
+            if (neighbor) return neighbor->remove_edge(dest, timestamp);
+
+            auto end = inline_edges + inline_num;
+            auto pos = inline_find(dest);
+            if (pos == end || pos->get_dest() != dest || pos->is_deleted()) return false;
+#ifdef ENABLE_TIMESTAMP
+            pos->delete_version(timestamp);
+#else
+#ifdef ENABLE_WEIGHT
+            std::copy(inline_weights + (pos - inline_edges) + 1, inline_weights + inline_num, inline_weights + (pos - inline_edges));
+#endif
+            std::move(pos + 1, end, pos);
+            inline_num--;
+#endif
+            return true;
+        }
+
+        uint64_t gc_edges(uint64_t timestamp) {
+            if (neighbor) return neighbor->gc(timestamp);
+
+            uint32_t keep = 0;
+            for (uint32_t i = 0; i < inline_num; i++) {
+                if (inline_edges[i].gc(timestamp)) continue;
+                if (keep != i) {
+                    inline_edges[keep] = std::move(inline_edges[i]);
+#ifdef ENABLE_WEIGHT
+                    inline_weights[keep] = inline_weights[i];
+#endif
+                }
+                keep++;
+            }
+            uint64_t removed = inline_num - keep;
+            inline_num = keep;
+            return removed;
+        }
+
+        template<typename F>
+        void fold_delta(uint64_t timestamp, F &&oldest_snapshot) {
+            if (neighbor) neighbor->fold_delta(timestamp, oldest_snapshot);
+        }
+
+        bool has_edge(uint64_t src, uint64_t dest, uint64_t timestamp) const {
+            if (neighbor) return neighbor->has_edge(src, dest, timestamp);
+
+            auto pos = inline_find(dest);
+            return pos != inline_edges + inline_num && pos->get_dest() == dest && pos->check_version(timestamp);
+        }
+
+        double get_weight(uint64_t dest, uint64_t timestamp) const {
+            if (neighbor) return neighbor->get_weight(dest, timestamp);
+
+            auto pos = inline_find(dest);
+            if (pos == inline_edges + inline_num || pos->get_dest() != dest || !pos->check_version(timestamp)) return std::numeric_limits<double>::quiet_NaN();
+            return inline_weight(pos - inline_edges);
+        }
+
+        template<typename F>
+        uint64_t edges(F&& callback, uint64_t timestamp) const {
+            if (neighbor) return neighbor->edges(callback, timestamp);
+
+            uint64_t sum = 0;
+            for (uint32_t i = 0; i < inline_num; i++) {
+                auto &entry = inline_edges[i];
+                if (entry.check_version(timestamp)) {
+                    bool should_continue = callback(entry.get_dest(), inline_weight(i));
+                    sum += entry.get_dest();
+                    if (!should_continue) break;
+                }
+            }
+            return sum;
+        }
+
+        uint64_t intersect(const VertexNeighbors<EdgeIndex, EdgeEntry, Inline> & other, uint64_t timestamp) const {
+            if (neighbor && other.neighbor) return neighbor->intersect(*other.neighbor, timestamp);
+            return intersect::neighbors(*this, other, timestamp);
+        }
+
+#ifdef ENABLE_LOCK
+        UnifiedIterator<EdgeEntry> get_begin(uint64_t timestamp, RWSpinLock *lock, bool read_only = true) const {
+            if (neighbor) return neighbor->get_begin(timestamp, lock, read_only);
+            return UnifiedIterator<EdgeEntry>(VectorIteratorImpl<EdgeEntry>{inline_edges, inline_edges + inline_num, timestamp}, lock, read_only);
+        }
+#else
+        UnifiedIterator<EdgeEntry> get_begin(uint64_t timestamp) const {
+            if (neighbor) return neighbor->get_begin(timestamp);
+            return UnifiedIterator<EdgeEntry>(VectorIteratorImpl<EdgeEntry>{inline_edges, inline_edges + inline_num, timestamp});
+        }
+#endif
+
+        void clear_neighbors() {
+            if (neighbor) {
+                neighbor->clear();
+                delete neighbor;
+                neighbor = nullptr;
+            }
+            for (uint32_t i = 0; i < inline_num; i++) inline_edges[i] = EdgeEntry();
+            inline_num = 0;
+        }
+
+    private:
+        double inline_weight(uint32_t idx) const {
+#ifdef ENABLE_WEIGHT
+            return inline_weights[idx];
+#else
+            return 0.0;
+#endif
+        }
+
+        EdgeEntry* inline_find(uint64_t dest) const {
+            return std::lower_bound(inline_edges, inline_edges + inline_num, dest, [] (const EdgeEntry &entry, uint64_t dest) {
+                return entry.get_dest() < dest;
+            });
+        }
+
+        // moves the inline edges into a fresh NeighborEntry, replaying their versions oldest first
+        void spill() {
+            neighbor = new NeighborEntry<EdgeIndex, EdgeEntry>();
+            std::vector<uint64_t> versions;
+            for (uint32_t i = 0; i < inline_num; i++) {
+                auto &entry = inline_edges[i];
+                versions.clear();
+                entry.get_versions(&versions);
+                for (int j = versions.size() - 1; j >= 0; j--) {
+                    if (is_tombstone(versions[j])) neighbor->remove_edge(entry.get_dest(), version_timestamp(versions[j]));
+                    else neighbor->insert_edge(entry.get_dest(), versions[j], inline_weight(i));
+                }
+                entry = EdgeEntry();
+            }
+            inline_num = 0;
+        }
+    };
+
+    /// Log entries cannot be replayed into an index and INLINE_EDGES 0 opts out of inlining, so the NeighborEntry
+    /// is allocated with the first edge instead.
+    template<template<typename> class EdgeIndex, typename EdgeEntry>
+    struct VertexNeighbors<EdgeIndex, EdgeEntry, false> {
+        NeighborEntry<EdgeIndex, EdgeEntry>* neighbor {nullptr};
+
+        VertexNeighbors() = default;
+
+        explicit VertexNeighbors(NeighborEntry<EdgeIndex, EdgeEntry>* neighbor_ptr) : neighbor(neighbor_ptr) {}
+
+        bool insert_edge(uint64_t dest, uint64_t timestamp, double weight = 0.0) {
+            if (!neighbor) neighbor = new NeighborEntry<EdgeIndex, EdgeEntry>();
+            return neighbor->insert_edge(dest, timestamp, weight);
+        }
+
+        uint64_t insert_edge_batch(const std::vector<uint64_t> &dest_list, uint64_t timestamp, const std::vector<double> &weight_list = {}) {
+            if (!neighbor) neighbor = new NeighborEntry<EdgeIndex, EdgeEntry>();
+            return neighbor->insert_edge_batch(dest_list, timestamp, weight_list);
+        }
+
+        bool remove_edge(uint64_t dest, uint64_t timestamp) {
+            return neighbor && neighbor->remove_edge(dest, timestamp);
+        }
+
+        uint64_t gc_edges(uint64_t timestamp) {
+            return neighbor ? neighbor->gc(timestamp) : 0;
+        }
+
+        template<typename F>
+        void fold_delta(uint64_t timestamp, F &&oldest_snapshot) {
+            if (neighbor) neighbor->fold_delta(timestamp, oldest_snapshot);
+        }
+
+        bool has_edge(uint64_t src, uint64_t dest, uint64_t timestamp) const {
+            return neighbor && neighbor->has_edge(src, dest, timestamp);
+        }
+
+        double get_weight(uint64_t dest, uint64_t timestamp) const {
+            return neighbor ? neighbor->get_weight(dest, timestamp) : std::numeric_limits<double>::quiet_NaN();
+        }
+
+        template<typename F>
+        uint64_t edges(F&& callback, uint64_t timestamp) const {
+            return neighbor ? neighbor->edges(callback, timestamp) : 0;
+        }
+
+        uint64_t intersect(const VertexNeighbors<EdgeIndex, EdgeEntry, false> & other, uint64_t timestamp) const {
+            if (!neighbor || !other.neighbor) return 0;
+            return neighbor->intersect(*other.neighbor, timestamp);
+        }
+
+#ifdef ENABLE_LOCK
+        UnifiedIterator<EdgeEntry> get_begin(uint64_t timestamp, RWSpinLock *lock, bool read_only = true) const {
+            if (neighbor) return neighbor->get_begin(timestamp, lock, read_only);
+            return UnifiedIterator<EdgeEntry>(VectorIteratorImpl<EdgeEntry>{nullptr, nullptr, timestamp}, lock, read_only);
+        }
+#else
+        UnifiedIterator<EdgeEntry> get_begin(uint64_t timestamp) const {
+            if (neighbor) return neighbor->get_begin(timestamp);
+            return UnifiedIterator<EdgeEntry>(VectorIteratorImpl<EdgeEntry>{nullptr, nullptr, timestamp});
+        }
+#endif
+
+        void clear_neighbors() {
+            if (neighbor) {
+                neighbor->clear();
+                delete neighbor;
+                neighbor = nullptr;
+            }
+        }
+    };
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace container {
+    /// A fixed set of threads that sleep until run() hands them a job
+    ///
+    /// The threads live as long as the pool, so a periodic task such as a gc pass does not pay for
+    /// thread creation every time, and whatever the threads keep in thread_local free lists is
+    /// reused by the next pass.
+    struct WorkerPool {
+        explicit WorkerPool(uint32_t num_threads = 0) {
+            for (uint32_t i = 0; i < num_threads; i++) m_threads.emplace_back(&WorkerPool::work, this);
+        }
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_stopped = true;
+            }
+            m_wake.notify_all();
+            for (auto &thread : m_threads) thread.join();
+        }
+
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        // the calling thread runs job as well, returns once every thread has finished it
+        void run(const std::function<void()> &job) {
+            if (m_threads.empty()) return job();
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_job = &job;
+                m_running = m_threads.size();
+                m_generation++;
+            }
+            m_wake.notify_all();
+            job();
+            std::unique_lock<std::mutex> guard(m_mutex);
+            m_done.wait(guard, [this] { return m_running == 0; });
+            m_job = nullptr;
+        }
+
+    private:
+        void work() {
+            uint64_t seen = 0;
+            std::unique_lock<std::mutex> guard(m_mutex);
+            while (true) {
+                m_wake.wait(guard, [&] { return m_stopped || m_generation != seen; });
+                if (m_stopped) return;
+                seen = m_generation;
+                auto job = m_job;
+                guard.unlock();
+                (*job)();
+                guard.lock();
+                if (--m_running == 0) m_done.notify_one();
+            }
+        }
+
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        const std::function<void()>* m_job = nullptr;
+        uint64_t m_generation = 0;
+        uint64_t m_running = 0;
+        bool m_stopped = false;
+    };
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include "vertex_index.cpp"
+#include "utils/types.hpp"
+#include "utils/config.hpp"
+#include "utils/art/art.hpp"
+
+namespace container {
+    /// ART-based vertex indexor for sparse, ordered vertex ids
+    ///
+    /// The tree maps each id to a heap-allocated entry, so entries never move. Lookups and inserts
+    /// synchronize through optimistic lock coupling inside the tree, and scans come out in id order.
+    template<
+        template<template<typename> class, typename> class VertexEntry,
+        template<typename> class EdgeIndex,
+        typename EdgeEntry
+    >
+    struct ARTVertexIndex {
+        using Entry = VertexEntry<EdgeIndex, EdgeEntry>;
+
+        ARTVertexIndex() = default;
+
+        ~ARTVertexIndex() {
+            clear();
+        }
+
+        // the tree synchronizes itself, only the vertex locks are real
+        bool lock(container::RequiredLock& lock) {
+            if (lock.idx == container::config::VERTEX_INDEX_LOCK_IDX) return true;
+            auto entry = m_tree.find(lock.idx);
+            if (entry == nullptr) {
+                throw std::runtime_error("Lock not found");
+            }
+            if (lock.is_exclusive) {
+                entry->lock();
+            } else {
+                entry->lock_shared();
+            }
+            return true;
+        }
+
+        bool unlock(container::RequiredLock& lock) {
+            if (lock.idx == container::config::VERTEX_INDEX_LOCK_IDX) return true;
+            auto entry = m_tree.find(lock.idx);
+            if (lock.is_exclusive) {
+                entry->unlock();
+            } else {
+                entry->unlock_shared();
+            }
+            return true;
+        }
+
+        bool has_vertex(uint64_t vertex) const {
+            return m_tree.find(vertex) != nullptr;
+        }
+
+        // an existing vertex keeps its entry, others may already hold a pointer to it
+        bool insert_vertex(uint64_t vertex, NeighborEntry<EdgeIndex, EdgeEntry>* neighbor_ptr, uint64_t timestamp = 0) {
+            auto entry = new Entry(vertex, timestamp, neighbor_ptr);
+            if (m_tree.insert(vertex, entry)) return true;
+            delete entry;
+            return false;
+        }
+
+        NeighborEntry<EdgeIndex, EdgeEntry>* get_neighbor_ptr(uint64_t vertex) const {
+            auto entry = m_tree.find(vertex);
+            if (entry == nullptr) {
+                throw std::runtime_error("Vertex not found");
+            }
+            return entry->neighbor;
+        }
+
+        // nullptr if the vertex does not exist
+        Entry* get_entry(uint64_t vertex) const {
+            return m_tree.find(vertex);
+        }
+
+        /// Visits the entries with ids in [lo, hi] in ascending order until the callback returns false
+        template<typename F>
+        void range_scan(uint64_t lo, uint64_t hi, F &&callback) const {
+            m_tree.scan(lo, hi, [&callback] (uint64_t vertex, Entry* entry) {
+                return callback(*entry);
+            });
+        }
+
+        template<typename F>
+        void foreach_entry(F &&callback) const {
+            m_tree.scan([&callback] (uint64_t vertex, Entry* entry) {
+                callback(*entry);
+                return true;
+            });
+        }
+
+        template<typename F>
+        void scan(F &&callback) const {
+            m_tree.scan([&callback] (uint64_t vertex, Entry* entry) {
+                callback(vertex);
+                return true;
+            });
+        }
+
+        void get_vertices(std::vector<uint64_t>& vertices) const {
+            scan([&vertices] (uint64_t vertex) {
+                vertices.push_back(vertex);
+            });
+        }
+
+        /// Hazard! Not thread-safe, the index is empty afterwards
+        void clear() {
+            m_tree.scan([] (uint64_t vertex, Entry* entry) {
+                entry->clear();
+                delete entry;
+                return true;
+            });
+            m_tree.clear();
+        }
+
+    private:
+        mutable art::Tree<Entry> m_tree;
+    };
+}
@@ -4,33 +4,50 @@
 #include <limits>
 #include <algorithm>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
-#include "utils/unordered_dense/include/ankerl/unordered_dense.h"
+#include "utils/dense_map.hpp"
 
 #include "utils/types.hpp"
 #include "utils/config.hpp"
 
 namespace container {
+    /// Hash-based vertex indexor for sparse vertex ids
+    ///
+    /// Vertices are spread over independent shards, each a small map guarded by its own lock, so
+    /// inserts only serialize with lookups that hash to the same shard. The maps store pointers to
+    /// heap-allocated entries, which keeps entry addresses (and their locks) stable across rehashes.
     template<
         template<template<typename> class, typename> class VertexEntry,
         template<typename> class EdgeIndex,
         typename EdgeEntry
     >
     struct HashmapVertexIndex {
+        using Entry = VertexEntry<EdgeIndex, EdgeEntry>;
+
+        static constexpr uint32_t SHARD_BITS = 6;
+        static constexpr uint32_t NUM_SHARDS = 1u << SHARD_BITS;
+
         HashmapVertexIndex() = default;
 
+        ~HashmapVertexIndex() {
+            clear();
+        }
+
+        // the shards protect themselves, only the vertex locks are real
         bool lock(container::RequiredLock& lock) {
             if (lock.idx == container::config::VERTEX_INDEX_LOCK_IDX) {
                 return true;
             }
-            auto iter = m_vertex_index.find(lock.idx);
-            if (iter == m_vertex_index.end()) {
+            auto entry = find(lock.idx);
+            if (entry == nullptr) {
                 throw std::runtime_error("Lock not found");
             }
             if (lock.is_exclusive) {
-                iter->second.lock();
+                entry->lock();
             } else {
-                iter->second.lock_shared();
+                entry->lock_shared();
             }
             return true;
         }
@@ -39,73 +56,111 @@ namespace container {
             if (lock.idx == container::config::VERTEX_INDEX_LOCK_IDX) {
                 return true;
             }
-            // find idx
-            auto iter = m_vertex_index.find(lock.idx);
+            auto entry = find(lock.idx);
             if (lock.is_exclusive) {
-                iter->second.unlock();
+                entry->unlock();
             } else {
-                iter->second.unlock_shared();
+                entry->unlock_shared();
             }
             return true;
         }
 
-        bool has_vertex(uint64_t vertex) {
-            return m_vertex_index.find(vertex) != m_vertex_index.end();
+        bool has_vertex(uint64_t vertex) const {
+            return find(vertex) != nullptr;
         }
 
+        // an existing vertex keeps its entry, others may already hold a pointer to it
         bool insert_vertex(uint64_t vertex, NeighborEntry<EdgeIndex, EdgeEntry>* neighbor_ptr, uint64_t timestamp = 0) {
-            VertexEntry<EdgeIndex, EdgeEntry> vertex_entry;
-            vertex_entry.vertex = vertex;
-            vertex_entry.neighbor = neighbor_ptr;
-            vertex_entry.update_degree(0, timestamp);
-            m_vertex_index[vertex] = VertexEntry<EdgeIndex, EdgeEntry>{vertex, timestamp, neighbor_ptr};
+            auto &shard = shard_of(vertex);
+            std::unique_lock<RWSpinLock> guard(shard.lock);
+            auto [iter, inserted] = shard.map.try_emplace(vertex, nullptr);
+            if (!inserted) return false;
+            iter->second = new Entry(vertex, timestamp, neighbor_ptr);
             return true;
         }
 
         NeighborEntry<EdgeIndex, EdgeEntry>* get_neighbor_ptr(uint64_t vertex) const {
-            auto iter = m_vertex_index.find(vertex);
-            if (iter == m_vertex_index.end()) {
+            return get_entry(vertex)->neighbor;
+        }
+
+        Entry* get_entry(uint64_t vertex) const {
+            auto entry = find(vertex);
+            if (entry == nullptr) {
                 throw std::runtime_error("Vertex not found");
             }
-            return iter->second.neighbor;
+            return entry;
         }
 
+        // visits the vertices shard by shard, each shard is locked while it is scanned
         template<typename F>
-        void scan(F &&callback) const {
-            uint64_t sz = m_vertex_index.size();
-            for (uint64_t i = 0; i < sz; i++) {
-                auto iter = m_vertex_index.find(i);
-                callback(iter->second.vertex);
+        void foreach_entry(F &&callback) const {
+            for (auto &shard : m_shards) {
+                std::shared_lock<RWSpinLock> guard(shard.lock);
+                for (auto &[vertex, entry] : shard.map) {
+                    callback(*entry);
+                }
             }
         }
 
-        void get_neighbor_ptrs(std::vector<EdgeIndex<EdgeEntry> *> &neighbor_ptrs) const {
-            for (auto & iter : m_vertex_index) {
-                neighbor_ptrs.push_back(iter.second.neighbor);
-            }
+        template<typename F>
+        void scan(F &&callback) const {
+            foreach_entry([&callback] (const Entry &entry) {
+                callback(entry.vertex);
+            });
         }
 
-        VertexEntry<EdgeIndex, EdgeEntry>* get_entry(uint64_t vertex) {
-            auto iter = m_vertex_index.find(vertex);
-            if (iter == m_vertex_index.end()) {
-                throw std::runtime_error("Vertex not found");
-            }
-            return &iter->second;
+        void get_neighbor_ptrs(std::vector<EdgeIndex<EdgeEntry> *> &neighbor_ptrs) const {
+            foreach_entry([&neighbor_ptrs] (const Entry &entry) {
+                neighbor_ptrs.push_back(entry.neighbor);
+            });
         }
 
-        void get_vertices(std::vector<uint64_t>& vertices) {
-            for (auto & iter : m_vertex_index) {
-                vertices.push_back(iter.second.vertex);
-            }
+        void get_vertices(std::vector<uint64_t>& vertices) const {
+            scan([&vertices] (uint64_t vertex) {
+                vertices.push_back(vertex);
+            });
         }
 
+        /// Hazard! Not thread-safe, the index is empty afterwards
         void clear() {
-            for (auto & iter : m_vertex_index) {
-                iter.second.clear();
+            for (auto &shard : m_shards) {
+                for (auto &[vertex, entry] : shard.map) {
+                    entry->clear();
+                    delete entry;
+                }
+                shard.map.clear();
             }
-            m_vertex_index.clear();
         }
 
-        ankerl::unordered_dense::map<uint64_t, VertexEntry<EdgeIndex, EdgeEntry>> m_vertex_index;
+    private:
+        struct alignas(64) Shard {
+            mutable RWSpinLock lock;
+            ankerl::unordered_dense::map<uint64_t, Entry*> map;
+
+            // with all 64 shard constructors inlined into one frame GCC 12 loses track of the
+            // bucket count and flags the memset in the map's clear_buckets()
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstringop-overflow"
+#endif
+            Shard() : map() {}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+        };
+
+        // the high bits of a multiplicative hash, consecutive ids land on different shards
+        Shard& shard_of(uint64_t vertex) const {
+            return m_shards[(vertex * 0x9E3779B97F4A7C15ull) >> (64 - SHARD_BITS)];
+        }
+
+        Entry* find(uint64_t vertex) const {
+            auto &shard = shard_of(vertex);
+            std::shared_lock<RWSpinLock> guard(shard.lock);
+            auto iter = shard.map.find(vertex);
+            return iter == shard.map.end() ? nullptr : iter->second;
+        }
+
+        mutable Shard m_shards[NUM_SHARDS];
     };
-}
\ No newline at end of file
+}
@@ -3,7 +3,9 @@
 #include <vector>
 #include <limits>
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <new>
 #include <stdexcept>
 
 #include "vertex_index.cpp"
@@ -11,120 +13,159 @@
 #include "utils/config.hpp"
 namespace container {
     /// Vector-based vertex indexor
+    ///
+    /// The entries live in chunks of doubling size (FIRST_CHUNK entries, then twice as many, ...),
+    /// which are allocated once and never move, so entry pointers and their locks stay valid while
+    /// other threads insert. An insert reserves its slot with a fetch_add and publishes it in slot
+    /// order; readers only ever look at the published prefix and need no index lock.
     template<
         template<template<typename> class, typename> class VertexEntry,
         template<typename> class EdgeIndex,
         typename EdgeEntry
     >
     struct VectorVertexIndex {
+        using Entry = VertexEntry<EdgeIndex, EdgeEntry>;
+
+        static constexpr uint32_t FIRST_CHUNK_BITS = 10;
+        static constexpr uint32_t MAX_CHUNKS = 64 - FIRST_CHUNK_BITS;
+
         VectorVertexIndex() {
-            m_vertex_index = new std::vector<VertexEntry<EdgeIndex, EdgeEntry>>();
+            for (auto &chunk : m_chunks) chunk.store(nullptr, std::memory_order_relaxed);
         }
 
         ~VectorVertexIndex() {
-            if (m_vertex_index) {
-                for (auto &vertex : *m_vertex_index) {
-                    vertex.clear();
-                }
-                delete m_vertex_index;
-            }
+            clear();
         }
 
+        // entries never move, so the index itself needs no lock; only the vertex locks are real
         bool lock(container::RequiredLock& lock) {
-            if (lock.idx == container::config::VERTEX_INDEX_LOCK_IDX) {
-                if (lock.is_exclusive) {
-                    m_lock.lock();
-                } else {
-                    m_lock.lock_shared();
-                }
+            if (lock.idx == container::config::VERTEX_INDEX_LOCK_IDX) return true;
+            if (lock.idx >= published()) {
+                throw std::runtime_error("Lock not found");
             }
-            else {
-                if (lock.idx >= m_vertex_index->size()) {
-                    throw std::runtime_error("Lock not found");
-                }
-                if (lock.is_exclusive) {
-                    (*m_vertex_index)[lock.idx].lock();
-                } else {
-                    (*m_vertex_index)[lock.idx].lock_shared();
-                }
+            if (lock.is_exclusive) {
+                slot(lock.idx)->lock();
+            } else {
+                slot(lock.idx)->lock_shared();
             }
             return true;
         }
 
         bool unlock(container::RequiredLock& lock) {
-            if (lock.idx == container::config::VERTEX_INDEX_LOCK_IDX) {
-                if (lock.is_exclusive) {
-                    m_lock.unlock();
-                } else {
-                    m_lock.unlock_shared();
-                }
-            }
-            else {
-                if (lock.is_exclusive) {
-                    (*m_vertex_index)[lock.idx].unlock();
-                } else {
-                    (*m_vertex_index)[lock.idx].unlock_shared();
-                }
+            if (lock.idx == container::config::VERTEX_INDEX_LOCK_IDX) return true;
+            if (lock.is_exclusive) {
+                slot(lock.idx)->unlock();
+            } else {
+                slot(lock.idx)->unlock_shared();
             }
             return true;
         }
 
         bool has_vertex(uint64_t vertex) const {
-            return vertex < size;
+            return vertex < published();
         }
 
         void get_vertices(std::vector<uint64_t>& vertices) const {
-            for(auto& vertex: *m_vertex_index) {
+            foreach_entry([&vertices] (const Entry &vertex) {
                 if (vertex.vertex != std::numeric_limits<uint64_t>::max()) {
                     vertices.push_back(vertex.vertex);
                 }
-            }
+            });
         }
 
         template<typename F>
         void scan(F &&callback) const { // TODO: change this to foreach_xx
-            for(auto& vertex: *m_vertex_index) {
+            foreach_entry([&callback] (const Entry &vertex) {
                 callback(vertex.vertex);
-            }
+            });
         }
 
+        // visits the entries published when the scan starts, chunk by chunk
         template<typename F>
         void foreach_entry(F &&callback) const {
-            for(auto& vertex: *m_vertex_index) {
-                callback(vertex);
+            uint64_t num = published();
+            for (uint32_t k = 0; num > 0; k++) {
+                auto chunk = m_chunks[k].load(std::memory_order_acquire);
+                uint64_t count = std::min(num, chunk_size(k));
+                for (uint64_t i = 0; i < count; i++) callback(chunk[i]);
+                num -= count;
             }
         }
 
         bool insert_vertex(uint64_t vertex, NeighborEntry<EdgeIndex, EdgeEntry>* neighbor_ptr, uint64_t timestamp = 0) {
-            VertexEntry<EdgeIndex, EdgeEntry> vertex_entry;
-            vertex_entry.vertex = size++;
-            vertex_entry.neighbor = neighbor_ptr;
-            vertex_entry.update_degree(0, timestamp);
-            m_vertex_index->push_back(std::move(vertex_entry));
+            uint64_t id = m_reserved.fetch_add(1, std::memory_order_relaxed);
+            auto entry = new (slot(id, true)) Entry();
+            entry->vertex = id;
+            entry->neighbor = neighbor_ptr;
+            entry->update_degree(0, timestamp);
+
+            // slots are published in order, wait for the inserts that reserved the ones before
+            uint64_t expected = id;
+            for (unsigned k = 0; !m_size.compare_exchange_weak(expected, id + 1, std::memory_order_release, std::memory_order_relaxed); k++) {
+                expected = id;
+                RWSpinLock::yield(k);
+            }
             return true;
         }
 
         NeighborEntry<EdgeIndex, EdgeEntry>* get_neighbor_ptr(uint64_t vertex) const {
-            return (*m_vertex_index)[vertex].neighbor;
+            return slot(vertex)->neighbor;
         }
 
-        VertexEntry<EdgeIndex, EdgeEntry>* get_entry(uint64_t vertex) const {
-            return &(*m_vertex_index)[vertex];
+        Entry* get_entry(uint64_t vertex) const {
+            return slot(vertex);
         }
 
+        /// Hazard! Not thread-safe, the index is empty afterwards
         void clear() {
-            if (m_vertex_index) {
-                for(auto& vertex: *m_vertex_index) {
-                    vertex.clear();
+            uint64_t num = published();
+            for (uint32_t k = 0; k < MAX_CHUNKS; k++) {
+                auto chunk = m_chunks[k].exchange(nullptr, std::memory_order_relaxed);
+                if (!chunk) continue;
+                uint64_t count = std::min(num, chunk_size(k));
+                for (uint64_t i = 0; i < count; i++) {
+                    chunk[i].clear();
+                    chunk[i].~Entry();
                 }
+                num -= count;
+                std::allocator<Entry>().deallocate(chunk, chunk_size(k));
+            }
+            m_size.store(0, std::memory_order_relaxed);
+            m_reserved.store(0, std::memory_order_relaxed);
+        }
 
-                m_vertex_index->clear();
-                delete m_vertex_index;
+        uint64_t published() const {
+            return m_size.load(std::memory_order_acquire);
+        }
+
+    private:
+        static constexpr uint64_t chunk_size(uint32_t k) {
+            return uint64_t(1) << (FIRST_CHUNK_BITS + k);
+        }
+
+        // vertex v is at offset v + FIRST_CHUNK - 2^(FIRST_CHUNK_BITS + k) of chunk k, its highest bit selects k
+        Entry* slot(uint64_t vertex, bool allocate = false) const {
+            uint64_t pos = vertex + chunk_size(0);
+            uint32_t k = 63 - __builtin_clzll(pos) - FIRST_CHUNK_BITS;
+            auto chunk = m_chunks[k].load(std::memory_order_acquire);
+            if (__builtin_expect(chunk == nullptr, 0)) {
+                if (!allocate) throw std::runtime_error("Vertex does not exist");
+                chunk = allocate_chunk(k);
             }
+            return chunk + (pos - chunk_size(k));
+        }
+
+        // whoever loses the race to install the chunk frees its own copy
+        Entry* allocate_chunk(uint32_t k) const {
+            auto fresh = std::allocator<Entry>().allocate(chunk_size(k));
+            Entry* expected = nullptr;
+            if (m_chunks[k].compare_exchange_strong(expected, fresh, std::memory_order_acq_rel)) return fresh;
+            std::allocator<Entry>().deallocate(fresh, chunk_size(k));
+            return expected;
         }
 
-        std::vector<VertexEntry<EdgeIndex, EdgeEntry>> *m_vertex_index;
-        RWSpinLock m_lock;
-        uint64_t size = 0;
+        mutable std::atomic<Entry*> m_chunks[MAX_CHUNKS];
+        std::atomic<uint64_t> m_reserved {0};     // slots handed out to inserts
+        std::atomic<uint64_t> m_size {0};         // slots whose entries are constructed
     };
-}
\ No newline at end of file
+}
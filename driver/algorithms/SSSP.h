@@ -67,8 +67,10 @@ gapbs::pvector<double> ssspExperiments<F, S>::sssp(uint64_t source) {
 
         size_t chunk_size = (curr_frontier_tail + m_num_threads - 1) / m_num_threads;
         wrapper::set_max_threads(m_method, m_num_threads);
+        // storage without weights counts hops
+        const bool weighted = wrapper::is_weighted(m_method);
         for (int i = 0; i < m_num_threads; i++) {
-            threads.emplace_back(std::thread([this, &dist, chunk_size, &curr_frontier_tail, &local_bins, &curr_bin_index, &frontier] (int thread_id) {
+            threads.emplace_back(std::thread([this, weighted, &dist, chunk_size, &curr_frontier_tail, &local_bins, &curr_bin_index, &frontier] (int thread_id) {
                 wrapper::init_thread(m_method, thread_id);
                 
                 auto snapshot_local = wrapper::snapshot_clone(m_snapshot);
@@ -80,10 +82,10 @@ gapbs::pvector<double> ssspExperiments<F, S>::sssp(uint64_t source) {
                     uint64_t u = frontier[i];
 
                     if (dist[u] >= m_delta * static_cast<double>(curr_bin_index)) {
-                        wrapper::snapshot_edges(snapshot_local, u, [this, &dist, &local_bins, u](uint64_t v, double w){
+                        wrapper::snapshot_edges(snapshot_local, u, [this, weighted, &dist, &local_bins, u](uint64_t v, double w){
                             if (v >= dist.size() || u >= dist.size() || u == v) return;
                             double old_dist = dist[v];
-                            double new_dist = dist[u] + 1;
+                            double new_dist = dist[u] + (weighted ? w : 1.0);
 
                             if (new_dist < old_dist) {
                                 bool changed_dist = true;
@@ -86,6 +86,7 @@ public:
                 neighbor_ptr->m_log_num += 1;
             }
         }
+        neighbor_ptr->compact();
     }
 
     void init_real_graph(std::vector<operation> & stream) {
@@ -107,6 +108,7 @@ public:
                 neighbor->get_neighbor_ptr()->m_filter->Add(graph[i][j]);
             }
             neighbor->get_neighbor_ptr()->m_log_num = graph[i].size();
+            neighbor->get_neighbor_ptr()->compact();
         }
     }
     
@@ -0,0 +1,208 @@
+#include <cstdint>
+#include <forward_list>
+
+#include "edge_wrapper.h"
+#include "types/types.hpp"
+#include "edge_driver.h"
+#include "container/edge_index/skiplist.hpp"
+#include "utils/types.hpp"
+
+// glibc malloc: 8 bytes of header, 16 bytes alignment and 32 bytes minimum per allocation
+inline uint64_t malloc_bytes(uint64_t size) {
+    return std::max<uint64_t>(32, (size + 8 + 15) & ~15ull);
+}
+
+// Compares the version layouts of the edge entries on the skiplist edge index:
+// the default build uses the inline-newest VersionEdgeEntry, VERSION_LAYOUT_LIST
+// builds the previous layout which keeps every version in a heap forward_list.
+
+#ifdef VERSION_LAYOUT_LIST
+struct ListVersionEdgeEntry {
+    uint64_t dest;
+    std::forward_list<uint64_t>* version_chain;
+
+    ListVersionEdgeEntry() : dest(std::numeric_limits<uint64_t>::max()), version_chain(nullptr) {}
+
+    explicit ListVersionEdgeEntry(uint64_t dest) : dest(dest), version_chain(nullptr) {}
+
+    ListVersionEdgeEntry(uint64_t dest, uint64_t timestamp) : dest(dest) {
+        version_chain = new std::forward_list<uint64_t>();
+        version_chain->push_front(timestamp);
+    }
+
+    ~ListVersionEdgeEntry() {
+        delete version_chain;
+    }
+
+    ListVersionEdgeEntry(const ListVersionEdgeEntry &) = delete;
+    ListVersionEdgeEntry &operator=(const ListVersionEdgeEntry &) = delete;
+
+    ListVersionEdgeEntry(ListVersionEdgeEntry &&other) noexcept : dest(other.dest), version_chain(other.version_chain) {
+        other.version_chain = nullptr;
+    }
+
+    ListVersionEdgeEntry &operator=(ListVersionEdgeEntry &&other) noexcept {
+        if (this != &other) {
+            delete version_chain;
+            dest = other.dest;
+            version_chain = other.version_chain;
+            other.version_chain = nullptr;
+        }
+        return *this;
+    }
+
+    bool operator<(const ListVersionEdgeEntry &rhs) const {
+        return dest < rhs.dest;
+    }
+
+    void update_version(uint64_t timestamp) {
+        if (!version_chain) version_chain = new std::forward_list<uint64_t>();
+        version_chain->push_front(timestamp);
+    }
+
+    void delete_version(uint64_t timestamp) {
+        update_version(timestamp | container::TOMBSTONE_BIT);
+    }
+
+    bool is_deleted() const {
+        return version_chain && !version_chain->empty() && container::is_tombstone(version_chain->front());
+    }
+
+    bool check_version(uint64_t timestamp) const {
+        for (auto version : *version_chain) {
+            if (container::version_timestamp(version) <= timestamp) return !container::is_tombstone(version);
+        }
+        return false;
+    }
+
+    uint64_t get_dest() const {
+        return dest;
+    }
+
+    bool gc(uint64_t timestamp) {
+        return false;
+    }
+
+    uint64_t version_bytes() const {
+        uint64_t versions = std::distance(version_chain->begin(), version_chain->end());
+        return malloc_bytes(sizeof(std::forward_list<uint64_t>)) + versions * malloc_bytes(2 * sizeof(uint64_t));
+    }
+};
+
+using EdgeEntry = ListVersionEdgeEntry;
+#else
+struct CompactVersionEdgeEntry : container::VersionEdgeEntry {
+    using container::VersionEdgeEntry::VersionEdgeEntry;
+
+    uint64_t version_bytes() const {
+        uint64_t bytes = 0;
+        for (auto node = older; node != nullptr; node = node->next) bytes += sizeof(container::VersionNode);
+        return bytes;
+    }
+};
+
+using EdgeEntry = CompactVersionEdgeEntry;
+#endif
+
+template<typename T>
+using EdgeIndexTemplate = container::SkipListEdgeIndex<T>;
+
+using VertexEntry = container::VertexEntry<EdgeIndexTemplate, EdgeEntry>;
+
+class VersionLayoutWrapper {
+private:
+    std::vector<VertexEntry> *m_vertex_table;
+    uint64_t m_num_vertices;
+    uint64_t m_num_edges;
+public:
+    VersionLayoutWrapper(uint64_t num_vertices) : m_num_edges(0) {
+        m_vertex_table = new std::vector<VertexEntry>(num_vertices);
+        m_num_vertices = num_vertices;
+        for (uint64_t i = 0; i < num_vertices; i++) {
+            (*m_vertex_table)[i].vertex = i;
+            (*m_vertex_table)[i].neighbor = new container::NeighborEntry<EdgeIndexTemplate, EdgeEntry>();
+            (*m_vertex_table)[i].update_degree(0, 0);
+        }
+    }
+
+    ~VersionLayoutWrapper() {
+        for (auto &vertex : *m_vertex_table) {
+            vertex.clear();
+        }
+        m_vertex_table->clear();
+        delete m_vertex_table;
+    }
+
+    void insert_edge(uint64_t src, uint64_t dest, uint64_t timestamp) {
+        m_num_edges += (*m_vertex_table)[src].neighbor->insert_edge(dest, timestamp);
+    }
+
+    bool has_edge(uint64_t src, uint64_t dest, uint64_t timestamp) {
+        return (*m_vertex_table)[src].neighbor->has_edge(src, dest, timestamp);
+    }
+
+    template<class F>
+    uint64_t edges(uint64_t src, F&& callback, uint64_t timestamp) {
+        return (*m_vertex_table)[src].neighbor->edges(callback, timestamp);
+    }
+
+    void init_neighbor(uint64_t src, std::vector<uint64_t> & dest, uint64_t start, uint64_t end, EdgeDriverConfig exp_cfg) {
+        // with version chains the initial edges are visible from 0, so scans walk the chains
+        for (uint64_t i = start; i < end; i++) {
+            insert_edge(src, dest[i], exp_cfg.test_version_chain ? 0 : i);
+        }
+
+        if (exp_cfg.test_version_chain) {
+            auto m_size = end - start;
+            std::mt19937 gen(exp_cfg.seed);
+            std::vector<int> versioned_dest(m_size);
+            std::iota(versioned_dest.begin(), versioned_dest.end(), start);
+            std::shuffle(versioned_dest.begin(), versioned_dest.end(), gen);
+
+            for (uint64_t j = 0; j < m_size * exp_cfg.timestamp_rate; j++) {
+                for (int k = 1; k <= exp_cfg.version_chain_length; k++) {
+                    insert_edge(src, dest[versioned_dest[j]], k);
+                }
+            }
+        }
+    }
+
+    void init_real_graph(std::vector<operation> & stream) {
+        for (uint64_t i = 0; i < stream.size(); i++) {
+            auto op = stream[i];
+            insert_edge(op.e.source, op.e.destination, i);
+        }
+    }
+
+    /// Bytes of the edge blocks and version storage per edge.
+    void report_memory() {
+        if (m_num_edges == 0) return;
+        uint64_t bytes = 0;
+        for (auto &vertex : *m_vertex_table) {
+            auto block = vertex.neighbor->get_neighbor_ptr()->m_skiplist->head;
+            while (block != nullptr) {
+                bytes += container::EdgeBlock<EdgeEntry>::bytes(block->capacity);
+                for (uint64_t i = 0; i < block->size; i++) bytes += block->entries()[i].version_bytes();
+                block = block->next_levels[0];
+            }
+        }
+        printf("entry size: %lu B, edges: %lu, bytes per edge: %.2lf\n", sizeof(EdgeEntry), m_num_edges, (double) bytes / m_num_edges);
+    }
+};
+
+void execute(EdgeDriverConfig exp_cfg) {
+    auto wrapper = VersionLayoutWrapper(exp_cfg.num_of_vertices);
+    EdgeDriver<VersionLayoutWrapper> d(wrapper, exp_cfg);
+    d.execute();
+    wrapper.report_memory();
+}
+
+
+void execute_real_graph(uint64_t num_vertices, EdgeDriverConfig exp_cfg) {
+    auto wrapper = VersionLayoutWrapper(num_vertices);
+    EdgeDriver<VersionLayoutWrapper> d(wrapper, exp_cfg);
+    d.execute_real_graph();
+    wrapper.report_memory();
+}
+
+#include "edge_driver_main.h"
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <optional>
 
 typedef uint64_t vertexID;
 typedef uint8_t label;
@@ -178,6 +179,17 @@ struct DriverConfig {
     int num_threads_scan{20};
 
     std::vector<concurrent_workload> concurrent_workloads;
+
+    // adaptive neighborhoods, unset values keep the container defaults
+    std::optional<uint64_t> vector_size;
+    std::optional<uint64_t> hash_neighbor_size;
+    std::optional<double> hash_read_ratio;
+
+    // garbage collection of the 2PL containers, unset values keep the container defaults
+    std::optional<uint64_t> gc_interval;
+    std::optional<uint32_t> gc_workers;
+    std::optional<uint64_t> gc_slice;
+    std::optional<uint64_t> snapshot_refresh_us;
 };
 
 
@@ -112,6 +112,15 @@ void commandLineParser::parse(const std::string& configFilePath) {
 
         ("concurrent_workloads", po::value<std::vector<std::string>>()->multitoken(), "concurrent workload parameters in the format workload_type=type target_stream_type=stream num_threads=4")
 
+        ("vector_size", po::value<uint64_t>(), "edges an adaptive neighborhood keeps in a sorted vector")
+        ("hash_neighbor_size", po::value<uint64_t>(), "edges from which an adaptive neighborhood may switch to a hash index, 0 disables it")
+        ("hash_read_ratio", po::value<double>(), "lookups per write an adaptive neighborhood needs before switching to a hash index")
+
+        ("gc_interval", po::value<uint64_t>(), "milliseconds between two garbage collection passes of the 2PL containers")
+        ("gc_workers", po::value<uint32_t>(), "threads sharing a garbage collection pass")
+        ("gc_slice", po::value<uint64_t>(), "dirty vertices a garbage collection worker takes at a time")
+        ("snapshot_refresh_us", po::value<uint64_t>(), "microseconds between two rescans of the open snapshots by writers")
+
         
         ("element_sizes, e", po::value<std::vector<int>>(&element_sizes)->multitoken(), "Enter a list of integers")
         ("neighbor_size", po::value<uint64_t>(), "number of elements of each neighborhood used in synthetic graph")
@@ -341,6 +350,34 @@ void commandLineParser::parse(const std::string& configFilePath) {
         }
     }
     
+    if (vm.count("vector_size")) {
+        vector_size = vm["vector_size"].as<uint64_t>();
+    }
+
+    if (vm.count("hash_neighbor_size")) {
+        hash_neighbor_size = vm["hash_neighbor_size"].as<uint64_t>();
+    }
+
+    if (vm.count("hash_read_ratio")) {
+        hash_read_ratio = vm["hash_read_ratio"].as<double>();
+    }
+
+    if (vm.count("gc_interval")) {
+        gc_interval = vm["gc_interval"].as<uint64_t>();
+    }
+
+    if (vm.count("gc_workers")) {
+        gc_workers = vm["gc_workers"].as<uint32_t>();
+    }
+
+    if (vm.count("gc_slice")) {
+        gc_slice = vm["gc_slice"].as<uint64_t>();
+    }
+
+    if (vm.count("snapshot_refresh_us")) {
+        snapshot_refresh_us = vm["snapshot_refresh_us"].as<uint64_t>();
+    }
+
     if (vm.count("num_threads")) {
         m_num_threads = vm["num_threads"].as<int>();
     } else {
@@ -649,6 +686,17 @@ DriverConfig commandLineParser::get_driver_config() {
     // concurrent
     config.concurrent_workloads = concurrent_workloads;
 
+    // adaptive neighborhoods
+    config.vector_size = vector_size;
+    config.hash_neighbor_size = hash_neighbor_size;
+    config.hash_read_ratio = hash_read_ratio;
+
+    // garbage collection
+    config.gc_interval = gc_interval;
+    config.gc_workers = gc_workers;
+    config.gc_slice = gc_slice;
+    config.snapshot_refresh_us = snapshot_refresh_us;
+
     return config;
 }
 
@@ -107,6 +107,17 @@ private:
     // concurrent
     std::vector<concurrent_workload> concurrent_workloads;
 
+    // adaptive neighborhoods
+    std::optional<uint64_t> vector_size;
+    std::optional<uint64_t> hash_neighbor_size;
+    std::optional<double> hash_read_ratio;
+
+    // garbage collection
+    std::optional<uint64_t> gc_interval;
+    std::optional<uint32_t> gc_workers;
+    std::optional<uint64_t> gc_slice;
+    std::optional<uint64_t> snapshot_refresh_us;
+
     // neighbor set test
     std::vector<int> element_sizes;
     uint64_t neighbor_size;